@@ -26,10 +26,12 @@
 #endif
 #define MEM_ALIGNMENT               4
 // #define MEM_SIZE                    4000
-#define MEM_SIZE                    20 * 1024 // SHM
+// #define MEM_SIZE                    20 * 1024 // SHM
+#define MEM_SIZE                    40 * 1024 // room made by the 4-bit framebuffer
 #define MEMP_NUM_TCP_SEG            32
 #define MEMP_NUM_ARP_QUEUE          10
-#define PBUF_POOL_SIZE              24
+// #define PBUF_POOL_SIZE              24
+#define PBUF_POOL_SIZE              40
 #define LWIP_ARP                    1
 #define LWIP_ETHERNET               1
 #define LWIP_ICMP                   1
@@ -94,9 +96,16 @@
 #define DHCP_DEBUG                  LWIP_DBG_OFF
 
 // SHM...
-#define MEMP_NUM_SYS_TIMEOUT        (LWIP_NUM_SYS_TIMEOUT_INTERNAL+1) 
+#define MEMP_NUM_SYS_TIMEOUT        (LWIP_NUM_SYS_TIMEOUT_INTERNAL+2) // MQTT and SNTP
 // #define MQTT_CYCLIC_TIMER_INTERVAL 1 - makes no difference
 #define MQTT_REQ_MAX_IN_FLIGHT      5
 #define MQTT_DEBUG                  LWIP_DBG_OFF
 
+// SNTP keeps the local clock (see src/sntp_clock.c) and resyncs hourly
+#include <stdint.h>
+void clock_sntp_set(uint32_t sec, uint32_t us);
+#define SNTP_SERVER_DNS             1
+#define SNTP_UPDATE_DELAY           (60 * 60 * 1000)
+#define SNTP_SET_SYSTEM_TIME_US(sec, us) clock_sntp_set(sec, us)
+
 #endif /* __LWIPOPTS_H__ */
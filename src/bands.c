@@ -0,0 +1,67 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * Framebuffer-less rendering.
+ *
+ * Instead of a 75 KB image, core0 just records the current text of each item here.
+ * When core1 sends a dirty region it rebuilds the screen a band at a time into a small
+ * buffer, from a copy of the items taken at the start of the frame, and sends that.
+ * The same glyph routines are used as for the framebuffer, so the pixels are identical.
+*/
+
+#include <string.h>
+
+#include "bands.h"
+
+#if USE_BAND_RENDER
+
+static text_item_t items[MAX_TEXT_ITEMS];           // current state (image mutex)
+static text_item_t render_items[MAX_TEXT_ITEMS];    // core1's copy for this frame
+static bool shown[MAX_TEXT_ITEMS];                  // items ever set (valid may be cleared by overlaps)
+static bool render_shown[MAX_TEXT_ITEMS];
+static image_row_t band_buf[BAND_LINES];
+
+void band_set_item (int slot, const char *text, uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+    graphics_lock();
+    // Only the character cells that changed need sending again
+    set_text_item(items, slot, text, x, y, fg, bg, st);
+    shown[slot] = true;
+    graphics_unlock();
+}
+
+void band_clear_item (int slot) {
+    int w, h;
+    graphics_lock();
+    if (shown[slot]) {
+        text_extent(&items[slot].style, strlen(items[slot].text), &w, &h);
+        mark_dirty(items[slot].x, items[slot].y, w, h);
+    }
+    items[slot].valid = false;
+    shown[slot] = false;
+    graphics_unlock();
+}
+
+void band_take_items () {
+    memcpy(render_items, items, sizeof(items));
+    memcpy(render_shown, shown, sizeof(shown));
+}
+
+image_row_t * band_render (int y0, int rows) {
+    int w, h;
+    memset(band_buf, (BLACK << 4) | BLACK, sizeof(band_buf));
+    graphics_begin_band(y0, rows);
+    for (int i = 0; i < MAX_TEXT_ITEMS; i++) {
+        text_item_t *it = &render_items[i];
+        if (!render_shown[i]) continue;
+        text_extent(&it->style, strlen(it->text), &w, &h);
+        if ((it->y + h <= y0) || (it->y >= y0 + rows)) continue;
+        show_band_item(band_buf, it);
+    }
+    graphics_end_band();
+    return band_buf;
+}
+
+#endif
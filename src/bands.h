@@ -0,0 +1,32 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef BANDS_H
+#define BANDS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "graphics.h"
+#include "image.h"
+#include "lcd.h"
+
+// Screen rows rendered into the band buffer at a time
+#define BAND_LINES 16
+
+// core0 - replace the text shown in a text item slot (see graphics.h), marking what changed dirty
+void band_set_item (int slot, const char *text, uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st);
+
+// core0 - stop showing a text item slot, so it is no longer rendered over anything beneath it
+void band_clear_item (int slot);
+
+// core1 - copy the retained items for this frame (caller holds the image mutex)
+void band_take_items ();
+
+// core1 - render screen rows y0 .. y0+rows-1 (rows <= BAND_LINES) from the taken items,
+// returning the band buffer, whose first row is screen row y0
+image_row_t * band_render (int y0, int rows);
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * A single-producer/single-consumer ring of draw commands from core0 to core1.
+ *
+ * head is only written by the producer and tail only by the consumer, so no lock is
+ * needed between the cores.  On core0 the producer can be either the main loop or an
+ * lwIP callback, so enqueueing is done with interrupts disabled to keep it single.
+ * When the ring is full the new command is dropped and counted.
+*/
+
+#include <string.h>
+
+#include "hardware/sync.h"
+
+#include "display_list.h"
+
+static dl_cmd_t ring[DL_QUEUE_LEN];
+static volatile uint32_t head;  // next slot to write (producer)
+static volatile uint32_t tail;  // next slot to read (consumer)
+static dl_stats_t stats;
+static text_item_t rendered[MAX_TEXT_ITEMS];   // what each text item last drew (core1)
+
+static bool dl_enqueue(const dl_cmd_t *cmd) {
+    uint32_t irq_status = save_and_disable_interrupts();
+    uint32_t used = head - tail;
+    if (used == DL_QUEUE_LEN) {
+        stats.dropped++;
+        restore_interrupts(irq_status);
+        return false;
+    }
+    ring[head & (DL_QUEUE_LEN - 1)] = *cmd;
+    __dmb();    // the command must be visible to core1 before the new head
+    head++;
+    stats.queued++;
+    if (used + 1 > stats.high_water) stats.high_water = used + 1;
+    restore_interrupts(irq_status);
+    return true;
+}
+
+bool dl_text (int slot, const char *msg, uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+    dl_cmd_t cmd = {.style = *st, .slot = slot, .fg = fg, .bg = bg, .x = x, .y = y};
+    strncpy(cmd.text, msg, DL_TEXT_MAX - 1);
+    return dl_enqueue(&cmd);
+}
+
+int dl_render (image_t img) {
+    int n = 0;
+    while (tail != head) {
+        __dmb();    // read the command only after seeing the head that published it
+        dl_cmd_t *cmd = &ring[tail & (DL_QUEUE_LEN - 1)];
+        show_text_item(img, rendered, cmd->slot, cmd->text, cmd->x, cmd->y, cmd->fg, cmd->bg, &cmd->style);
+        tail++;
+        ++n;
+    }
+    stats.rendered += n;
+    return n;
+}
+
+void dl_get_stats (dl_stats_t *s) {
+    *s = stats;
+}
@@ -0,0 +1,54 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef DISPLAY_LIST_H
+#define DISPLAY_LIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "graphics.h"
+#include "image.h"
+
+// When true, core0 queues draw commands and core1 rasterises them into the image,
+// instead of core0 drawing directly in the MQTT callback
+#define USE_DISPLAY_LIST false
+
+#if USE_DISPLAY_LIST && USE_BAND_RENDER
+#error "USE_DISPLAY_LIST needs a framebuffer, so cannot be combined with USE_BAND_RENDER"
+#endif
+
+// Number of queued commands - must be a power of 2
+#define DL_QUEUE_LEN 32
+
+// Longest text a single command carries (including the terminating NUL)
+#define DL_TEXT_MAX TEXT_MAX
+
+// Each command draws one text item
+typedef struct {
+    text_style_t style;
+    uint8_t  slot;          // text item slot, so only changed characters are redrawn
+    colour_t fg;
+    colour_t bg;
+    uint16_t x, y;
+    char     text[DL_TEXT_MAX];
+} dl_cmd_t;
+
+typedef struct {
+    uint32_t queued;        // commands accepted
+    uint32_t rendered;      // commands rasterised by core1
+    uint32_t dropped;       // commands refused because the queue was full
+    uint32_t high_water;    // most commands ever waiting at once
+} dl_stats_t;
+
+// Producer side - core0 only
+bool dl_text  (int slot, const char *msg, uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st);
+
+// Consumer side - core1 only; returns the number of commands rasterised
+int  dl_render (image_t img);
+
+void dl_get_stats (dl_stats_t *s);
+
+#endif
@@ -17,40 +17,132 @@
 #include "font_5x7.h"
 // #include "font_led.h"
 
-const rgb_t BLACK   = {0, 0, 0};
-const rgb_t RED   = {3, 0, 0};
-const rgb_t GREEN = {0, 3, 0};
-const rgb_t BLUE  = {0, 0, 3};
-const rgb_t WHITE = {3, 3, 3};
-const rgb_t CYAN = {0, 3, 3};
-const rgb_t MAGENTA = {3, 0, 3};
-const rgb_t YELLOW = {3, 3, 0};
+// Entries must stay in the same order as the colour_t names in image.h
+// Entries 8 to 15 are spare (black)
+const rgb_t palette[PALETTE_SIZE] = {
+    [BLACK]   = {0, 0, 0},
+    [RED]     = {3, 0, 0},
+    [GREEN]   = {0, 3, 0},
+    [BLUE]    = {0, 0, 3},
+    [WHITE]   = {3, 3, 3},
+    [CYAN]    = {0, 3, 3},
+    [MAGENTA] = {3, 0, 3},
+    [YELLOW]  = {3, 3, 0},
+};
 
 mutex_t * img_mu;
 
+static rect_t dirty_rects[MAX_DIRTY_RECTS];
+static int dirty_count;
+
+#if USE_BAND_RENDER
+// While rendering a band, img holds only screen rows band_y0 .. band_y1-1 and nothing is marked dirty
+static int band_y0 = 0, band_y1 = LCD_HEIGHT;
+static bool drawing_band;
+
+static inline void put_pixel(image_row_t *img, int x, int y, colour_t c) {
+    if ((y >= band_y0) && (y < band_y1)) image_set(img, x, y - band_y0, c);
+}
+
+void graphics_begin_band(int y0, int rows) {
+    band_y0 = y0;
+    band_y1 = y0 + rows;
+    drawing_band = true;
+}
+
+void graphics_end_band() {
+    band_y0 = 0;
+    band_y1 = LCD_HEIGHT;
+    drawing_band = false;
+}
+#else
+#define band_y0 0
+#define band_y1 LCD_HEIGHT
+#define drawing_band false
+#define put_pixel image_set
+#endif
+
+static void transpose_fonts ();
+
 void graphics_init(mutex_t * image_mutex) {
     img_mu = image_mutex;
+    transpose_fonts();
+}
+
+void graphics_lock() {
+    mutex_enter_blocking(img_mu);
+}
+
+void graphics_unlock() {
+    mutex_exit(img_mu);
 }
 
-rgb_t string2rgb(const char *s) {
-    if (strcmp("BLACK", s) == 0) return BLACK;
-    if (strcmp("RED", s) == 0) return RED;
-    if (strcmp("GREEN", s) == 0) return GREEN;
-    if (strcmp("BLUE", s) == 0) return BLUE;
-    if (strcmp("WHITE", s) == 0) return WHITE;
-    if (strcmp("CYAN", s) == 0) return CYAN;
-    if (strcmp("MAGENTA", s) == 0) return MAGENTA;
-    if (strcmp("YELLOW", s) == 0) return YELLOW;
-    // failsafe
-    return WHITE;
+static void rect_union(rect_t *a, const rect_t *b) {
+    uint16_t x1 = (a->x + a->w > b->x + b->w) ? a->x + a->w : b->x + b->w;
+    uint16_t y1 = (a->y + a->h > b->y + b->h) ? a->y + a->h : b->y + b->h;
+    if (b->x < a->x) a->x = b->x;
+    if (b->y < a->y) a->y = b->y;
+    a->w = x1 - a->x;
+    a->h = y1 - a->y;
 }
 
-void show_line (image_t img, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, rgb_t col) {
+static int rect_area(const rect_t *r) {
+    return r->w * r->h;
+}
+
+static bool rects_touch(const rect_t *a, const rect_t *b) {
+    return (a->x <= b->x + b->w) && (b->x <= a->x + a->w) &&
+           (a->y <= b->y + b->h) && (b->y <= a->y + a->h);
+}
+
+/* mark_dirty records that the given area of the image has changed and needs sending to the LCD.
+   Touching regions are merged, and when the list is full the new region is merged with
+   whichever existing one grows the least. */
+void mark_dirty (int x, int y, int width, int height) {
+    if (x < 0) { width += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+    if (x + width > LCD_WIDTH) width = LCD_WIDTH - x;
+    if (y + height > LCD_HEIGHT) height = LCD_HEIGHT - y;
+    if ((width <= 0) || (height <= 0)) return;
+    rect_t r = {x, y, width, height};
+    for (int i = 0; i < dirty_count; ++i) {
+        if (rects_touch(&dirty_rects[i], &r)) {
+            rect_union(&dirty_rects[i], &r);
+            return;
+        }
+    }
+    if (dirty_count < MAX_DIRTY_RECTS) {
+        dirty_rects[dirty_count++] = r;
+        return;
+    }
+    int best = 0, best_growth = -1;
+    for (int i = 0; i < dirty_count; ++i) {
+        rect_t u = dirty_rects[i];
+        rect_union(&u, &r);
+        int growth = rect_area(&u) - rect_area(&dirty_rects[i]);
+        if ((best_growth < 0) || (growth < best_growth)) {
+            best = i;
+            best_growth = growth;
+        }
+    }
+    rect_union(&dirty_rects[best], &r);
+}
+
+/* take_dirty_rects copies out the current dirty list, clears it, and returns the count */
+int take_dirty_rects (rect_t rects[MAX_DIRTY_RECTS]) {
+    int n = dirty_count;
+    memcpy(rects, dirty_rects, n * sizeof(rect_t));
+    dirty_count = 0;
+    return n;
+}
+
+void show_line (image_t img, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, colour_t col) {
     int dx = abs(x1-x0), sx = x0<x1 ? 1 : -1;
     int dy = abs(y1-y0), sy = y0<y1 ? 1 : -1; 
     int err = (dx>dy ? dx : -dy)/2, e2;    
+    if (!drawing_band) mark_dirty(x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1, dx + 1, dy + 1);
     for(;;){
-        img[x0][y0] = col;
+        put_pixel(img, x0, y0, col);
         if (x0==x1 && y0==y1) break;
         e2 = err;
         if (e2 >-dx) { err -= dy; x0 += sx; }
@@ -59,14 +151,11 @@ void show_line (image_t img, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1,
 }
 
 void clear_to_black (image_t img) {    
-    for (int x = 0; x < LCD_WIDTH; ++x) {
-        for (int y = 0; y < LCD_HEIGHT; ++y) {
-            img[x][y] = BLACK;
-        }
-    }    
+    memset(img, (BLACK << 4) | BLACK, sizeof(image_t));
+    mark_dirty(0, 0, LCD_WIDTH, LCD_HEIGHT);
 }
 
-// void show_sisd_char (image_t img, unsigned char c, rgb_t fg, uint16_t x, uint16_t y, 
+// void show_sisd_char (image_t img, unsigned char c, colour_t fg, uint16_t x, uint16_t y, 
 //                      uint16_t half_width, uint16_t half_height) {
 //     if ((x + (2 * half_width) < LCD_WIDTH) && (y + (2 * half_height) < LCD_HEIGHT)) {
 //         if ((LED_16_SEG[c] & 0b0000000000000000) != 0) {
@@ -75,179 +164,294 @@ void clear_to_black (image_t img) {
 //     }
 // }
 
-void show_3x5_char (image_t img, unsigned char c, rgb_t fg, rgb_t bg, uint16_t x, uint16_t y) {
-    uint16_t col = 0;
-    if ((x < (LCD_WIDTH - 3)) && (y < (LCD_HEIGHT - 4))) { // Don't draw outside bounds        
-        while (col < 3) {
-            img[x + col][y + 4] = ((font_3x5[c][col] & 0b00100000) != 0) ? fg : bg;
-            img[x + col][y + 3] = ((font_3x5[c][col] & 0b00010000) != 0) ? fg : bg;
-            img[x + col][y + 2] = ((font_3x5[c][col] & 0b00001000) != 0) ? fg : bg;
-            img[x + col][y + 1] = ((font_3x5[c][col] & 0b00000100) != 0) ? fg : bg;
-            img[x + col][y]     = ((font_3x5[c][col] & 0b00000010) != 0) ? fg : bg;
-            ++col;
-        }        
+/* fill_span sets a horizontal run of pixels, a whole byte (pixel pair) at a time where possible */
+static void fill_span (image_row_t *img, int x, int y, int width, colour_t col) {
+    if (x & 1) {
+        image_set(img, x, y, col);
+        ++x;
+        --width;
     }
+    if (width <= 0) return;
+    memset(&img[y][x >> 1], (col << 4) | col, width >> 1);
+    if (width & 1) image_set(img, x + width - 1, y, col);
 }
 
-void show_5x7_char (image_t img, unsigned char c, rgb_t fg, rgb_t bg, uint16_t x, uint16_t y) {
-    uint16_t col = 0;
-    if ((x < (LCD_WIDTH - 5)) && (y < (LCD_HEIGHT - 7))) { // Don't draw outside bounds        
-        while (col < 5) {
-            img[x + col][y + 6] = ((font_5x7[c][col] & 0b01000000) != 0) ? fg : bg;
-            img[x + col][y + 5] = ((font_5x7[c][col] & 0b00100000) != 0) ? fg : bg;
-            img[x + col][y + 4] = ((font_5x7[c][col] & 0b00010000) != 0) ? fg : bg;
-            img[x + col][y + 3] = ((font_5x7[c][col] & 0b00001000) != 0) ? fg : bg;
-            img[x + col][y + 2] = ((font_5x7[c][col] & 0b00000100) != 0) ? fg : bg;
-            img[x + col][y + 1] = ((font_5x7[c][col] & 0b00000010) != 0) ? fg : bg;
-            img[x + col][y]     = ((font_5x7[c][col] & 0b00000001) != 0) ? fg : bg;
-            ++col;
-        }        
-    }
+void show_block (image_row_t *img, uint16_t x, uint16_t y, int width, int height, colour_t col) {    
+    if (x + width > LCD_WIDTH) width = LCD_WIDTH - x;
+    if (width <= 0) return;
+    int y_end = y + height;
+    if (y_end > band_y1) y_end = band_y1;
+    for (int iy = (y > band_y0) ? y : band_y0; iy < y_end; ++iy) {
+        fill_span(img, x, iy - band_y0, width, col);
+    }    
 }
 
-void show_6x10_char (image_t img, unsigned char c, rgb_t fg, rgb_t bg, uint16_t x, uint16_t y) {
-    uint16_t col = 0;
-    if ((x < (LCD_WIDTH - 6)) && (y < (LCD_HEIGHT - 10))) { // Don't draw outside bounds        
-        while (col < 3) {
-            img[x + (col * 2)][y + 8]     = ((font_3x5[c][col] & 0b00100000) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 9]     = ((font_3x5[c][col] & 0b00100000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 8] = ((font_3x5[c][col] & 0b00100000) != 0) ? fg : bg;
-            img[x + (1 + col * 2)][y + 9] = ((font_3x5[c][col] & 0b00100000) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y + 6]     = ((font_3x5[c][col] & 0b00010000) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 7]     = ((font_3x5[c][col] & 0b00010000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 6] = ((font_3x5[c][col] & 0b00010000) != 0) ? fg : bg;
-            img[x + (1 + col * 2)][y + 7] = ((font_3x5[c][col] & 0b00010000) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y + 4]     = ((font_3x5[c][col] & 0b00001000) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 5]     = ((font_3x5[c][col] & 0b00001000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 4] = ((font_3x5[c][col] & 0b00001000) != 0) ? fg : bg;
-            img[x + (1 + col * 2)][y + 5] = ((font_3x5[c][col] & 0b00001000) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y + 2]     = ((font_3x5[c][col] & 0b00000100) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 3]     = ((font_3x5[c][col] & 0b00000100) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 2] = ((font_3x5[c][col] & 0b00000100) != 0) ? fg : bg;
-            img[x + (1 + col * 2)][y + 3] = ((font_3x5[c][col] & 0b00000100) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y]         = ((font_3x5[c][col] & 0b00000010) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 1]     = ((font_3x5[c][col] & 0b00000010) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y]     = ((font_3x5[c][col] & 0b00000010) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 1] = ((font_3x5[c][col] & 0b00000010) != 0) ? fg : bg;
-            ++col;
-        }        
+/* Font layout: each character is 'cols' bytes, one per column, with the top row in bit 'first_bit' */
+typedef struct {
+    const uint8_t *glyphs;
+    uint8_t cols;
+    uint8_t rows;
+    uint8_t first_bit;
+} font_desc_t;
+
+static const font_desc_t fonts[] = {
+    [FONT_3X5] = {&font_3x5[0][0], 3, FONT_ROWS(FONT_3X5), 1},
+    [FONT_5X7] = {&font_5x7[0][0], 5, FONT_ROWS(FONT_5X7), 0},
+};
+
+#define FONT_CHARS 128
+#define FONT_MAX_ROWS 7
+
+// The fonts transposed by graphics_init(): bit 'col' of font_rows[font][c][row] is that font pixel
+static uint8_t font_rows[2][FONT_CHARS][FONT_MAX_ROWS];
+
+static void transpose_fonts () {
+    memset(font_rows, 0, sizeof(font_rows));
+    for (int font = FONT_3X5; font <= FONT_5X7; ++font) {
+        const font_desc_t *f = &fonts[font];
+        for (int c = 0; c < FONT_CHARS; ++c) {
+            for (int col = 0; col < f->cols; ++col) {
+                uint8_t bits = f->glyphs[(c * f->cols) + col] >> f->first_bit;
+                for (int r = 0; r < f->rows; ++r) font_rows[font][c][r] |= ((bits >> r) & 1) << col;
+            }
+        }
     }
 }
 
-void show_10x14_char (image_t img, unsigned char c, rgb_t fg, rgb_t bg, uint16_t x, uint16_t y) {
-    uint16_t col = 0;
-    if ((x < (LCD_WIDTH - 10)) && (y < (LCD_HEIGHT - 14))) { // Don't draw outside bounds        
-        while (col < 5) {
-            img[x + (col * 2)][y + 12] = ((font_5x7[c][col] & 0b01000000) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 13] = ((font_5x7[c][col] & 0b01000000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 12] = ((font_5x7[c][col] & 0b01000000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 13] = ((font_5x7[c][col] & 0b01000000) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y + 10] = ((font_5x7[c][col] & 0b00100000) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 11] = ((font_5x7[c][col] & 0b00100000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 10] = ((font_5x7[c][col] & 0b00100000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 11] = ((font_5x7[c][col] & 0b00100000) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y + 8] = ((font_5x7[c][col] & 0b00010000) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 9] = ((font_5x7[c][col] & 0b00010000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 8] = ((font_5x7[c][col] & 0b00010000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 9] = ((font_5x7[c][col] & 0b00010000) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y + 6] = ((font_5x7[c][col] & 0b00001000) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 7] = ((font_5x7[c][col] & 0b00001000) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 6] = ((font_5x7[c][col] & 0b00001000) != 0) ? fg : bg;
-            img[x + (1 + col * 2)][y + 7] = ((font_5x7[c][col] & 0b00001000) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y + 4] = ((font_5x7[c][col] & 0b00000100) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 5] = ((font_5x7[c][col] & 0b00000100) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 4] = ((font_5x7[c][col] & 0b00000100) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 5] = ((font_5x7[c][col] & 0b00000100) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y + 2] = ((font_5x7[c][col] & 0b00000010) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 3] = ((font_5x7[c][col] & 0b00000010) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 2] = ((font_5x7[c][col] & 0b00000010) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 3] = ((font_5x7[c][col] & 0b00000010) != 0) ? fg : bg;
-
-            img[x + (col * 2)][y]         = ((font_5x7[c][col] & 0b00000001) != 0) ? fg : bg;
-            img[x + (col * 2)][y + 1]     = ((font_5x7[c][col] & 0b00000001) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y]         = ((font_5x7[c][col] & 0b00000001) != 0) ? fg : bg;
-            img[x + 1 + (col * 2)][y + 1]     = ((font_5x7[c][col] & 0b00000001) != 0) ? fg : bg;
-
-            ++col;
-        }        
+/* How each supported font/scale combination is laid out on screen */
+// Pixel scales are powers of two, so that font columns map to screen pixels by shifting, and
+// pitches are even, so that every character cell of a string starts on the same nibble
+#define CHECK_STYLE(font, scale, pixel_scale, pitch, ...) \
+    _Static_assert(((pixel_scale) & ((pixel_scale) - 1)) == 0, "pixel scale must be a power of two"); \
+    _Static_assert(((pitch) & 1) == 0, "pitch must be even"); \
+    _Static_assert((pitch) <= CELL_MAX_WIDTH, "character cell too wide for CELL_MAX_WIDTH"); \
+    _Static_assert(FONT_COLS(font) * (pixel_scale) < (pitch), "no gap between characters");
+TEXT_STYLES(CHECK_STYLE)
+#undef CHECK_STYLE
+
+/* text_rows draws the character cells of s[0..len) at (x, y): each glyph, its font pixels
+   (1 << shift) squares, then the gap to the next.  Each font row of the text is composed once as
+   packed pixel pairs, from the glyphs' row masks (see transpose_fonts), and copied to every screen
+   row it covers, keeping only the neighbouring nibbles at a ragged start or end.  The bounds are
+   checked once, here: only glyphs that fit entirely are drawn, the rest of the text being cleared
+   as far as the edge.  It is inlined with constant sizes, scales and phases (x & 1), so that the
+   composing loops unroll. */
+static inline __attribute__((always_inline))
+void text_rows (image_row_t *img, const char *s, int len, font_t font, int cols, int rows, int shift,
+                int pitch, int phase, colour_t fg, colour_t bg, uint16_t x, uint16_t y) {
+    const uint8_t pairs[4] = {bg | (bg << 4), fg | (bg << 4), bg | (fg << 4), fg | (fg << 4)};
+    const int cell_bytes = pitch / 2;
+    int width = len * pitch;
+    if (x + width > LCD_WIDTH) width = LCD_WIDTH - x;
+    if (width <= 0) return;
+    int shown = 0;
+    int room = LCD_WIDTH - x - (cols << shift);
+    if ((room >= 0) && (y + (rows << shift) <= LCD_HEIGHT)) shown = room / pitch + 1;
+    if (shown > len) shown = len;
+    const int cells = (width + pitch - 1) / pitch;
+    const int n = (phase + width + 1) >> 1;             // bytes the text touches in each row
+    const bool ragged_end = (phase + width) & 1;
+
+    for (int r = 0; r < rows; ++r) {
+        int y0 = y + (r << shift), y1 = y0 + (1 << shift);
+        if (y0 < band_y0) y0 = band_y0;
+        if (y1 > band_y1) y1 = band_y1;
+        if (y0 >= y1) continue;
+        // with an odd phase each cell's last pixel, which is gap, falls in the next cell's first byte
+        uint8_t line[LCD_WIDTH / 2 + CELL_MAX_WIDTH / 2 + 1];
+        uint8_t *out = line;
+        for (int i = 0; i < cells; ++i, out += cell_bytes) {
+            uint64_t lit = 0;                           // bit j: pixel j of the cell, less the phase
+            if (i < shown) {
+                unsigned char c = s[i];
+                uint8_t bits = font_rows[font][(c < FONT_CHARS) ? c : 0][r];
+                if (shift == 0) {
+                    lit = bits;
+                } else {
+                    for (int col = 0; col < cols; ++col) {
+                        lit |= (uint64_t)(((bits >> col) & 1) * ((1u << (1 << shift)) - 1)) << (col << shift);
+                    }
+                }
+                lit <<= phase;
+            }
+            for (int k = 0; k < cell_bytes; ++k) out[k] = pairs[(lit >> (2 * k)) & 3];
+        }
+        *out = pairs[0];
+        for (int iy = y0; iy < y1; ++iy) {
+            uint8_t *dst = &img[iy - band_y0][x >> 1];
+            uint8_t first = dst[0], last = dst[n - 1];
+            memcpy(dst, line, n);
+            if (phase) dst[0] = (dst[0] & 0xf0) | (first & 0x0f);
+            if (ragged_end) dst[n - 1] = (dst[n - 1] & 0x0f) | (last & 0xf0);
+        }
     }
 }
 
-void show_block (image_t img, uint16_t x, uint16_t y, int width, int height, rgb_t col) {    
-    for (int ix = x; ix < x + width; ++ix) {
-        for (int iy = y; iy < y + height; ++iy) {
-            if ((iy < LCD_HEIGHT) && (ix < LCD_WIDTH)) img[ix][iy] = col;
-        }
-    }    
+/* draw_cells draws the character cells of s[0..len) in the given style, foreground and
+   background, so that nothing need be cleared first */
+static void draw_cells (image_row_t *img, const text_style_t *st, const char *s, int len, colour_t fg, colour_t bg,
+                        uint16_t x, uint16_t y) {
+#define CELLS(font, cols, rows, shift, pitch) \
+    if (x & 1) text_rows(img, s, len, font, cols, rows, shift, pitch, 1, fg, bg, x, y); \
+    else text_rows(img, s, len, font, cols, rows, shift, pitch, 0, fg, bg, x, y);
+#define DRAW_STYLE(f, s, ps, p, ...) \
+    if ((st->font == f) && (st->pixel_scale == ps) && (st->pitch == p)) { \
+        CELLS(f, FONT_COLS(f), FONT_ROWS(f), __builtin_ctz(ps), p) \
+    } else
+    TEXT_STYLES(DRAW_STYLE)
+    {}
+#undef DRAW_STYLE
+#undef CELLS
 }
 
-void show_40x56_char (image_t img, unsigned char c, rgb_t fg, uint16_t x, uint16_t y) {
-    if ((x < (LCD_WIDTH - 40)) && (y < (LCD_HEIGHT - 56))) { // Don't draw outside bounds
-        for (int font_row = 0; font_row < 7; font_row++) {
-            for (int font_col = 0; font_col < 5; font_col++) {
-                if ((font_5x7[c][font_col] & (1 << font_row)) != 0) {
-                    show_block(img, x + (font_col * 8), y + (font_row * 8), 8, 8, fg);
-                }
-            }
-        }
-    }
+/* draw_text draws msg in the given style */
+static void draw_text (image_row_t *img, const char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+    int len = strlen(msg);
+    if (!drawing_band) mark_dirty(x, y, len * st->pitch, fonts[st->font].rows * st->pixel_scale);
+    draw_cells(img, st, msg, len, fg, bg, x, y);
 }
 
-void show_3x5_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg) {
-    // clear background
-    int w = strlen(msg) * 4; // 1 pixel gap between chars
-    show_block(img, x, y, w, 5, bg);
-    for (unsigned int ix = 0; ix < strlen(msg); ++ix) {
-        show_3x5_char(img, msg[ix], fg, bg, x + (ix * 4), y);
-    }
+static void show_text (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+    mutex_enter_blocking(img_mu);
+    draw_text(img, msg, x, y, fg, bg, st);
+    mutex_exit(img_mu);
 }
 
-void show_5x7_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg) {
-    // clear background
-    int w = strlen(msg) * 6; // 1 pixel gap between chars
-    show_block(img, x, y, w, 7, bg);
-    for (unsigned int ix = 0; ix < strlen(msg); ++ix) {
-        show_5x7_char(img, msg[ix], fg, bg, x + (ix * 6), y);
-    }
+void show_3x5_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg) {
+    static const text_style_t st = TEXT_STYLE(FONT_3X5, 1);
+    show_text(img, msg, x, y, fg, bg, &st);
 }
 
-void show_6x10_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg) {
-    // clear background
-    int w = strlen(msg) * 8; // 2 pixel gap between chars
-    show_block(img, x, y, w, 10, bg);
-    for (unsigned int ix = 0; ix < strlen(msg); ++ix) {
-        show_6x10_char(img, msg[ix], fg, bg, x + (ix * 8), y);
-    }
+void show_5x7_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg) {
+    static const text_style_t st = TEXT_STYLE(FONT_5X7, 1);
+    show_text(img, msg, x, y, fg, bg, &st);
 }
 
-void show_10x14_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg) {
-    // clear background
-    int w = strlen(msg) * 14; // 4 pixel gap between chars
-    mutex_enter_blocking(img_mu);
-    show_block(img, x, y, w, 14, bg);
-    for (unsigned int ix = 0; ix < strlen(msg); ++ix) {
-        show_10x14_char(img, msg[ix], fg, bg, x + (ix * 14), y);
+void show_6x10_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg) {
+    static const text_style_t st = TEXT_STYLE(FONT_3X5, 2);
+    show_text(img, msg, x, y, fg, bg, &st);
+}
+
+void show_10x14_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg) {
+    static const text_style_t st = TEXT_STYLE(FONT_5X7, 2);
+    show_text(img, msg, x, y, fg, bg, &st);
+}
+
+void show_40x56_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg) {
+    static const text_style_t st = TEXT_STYLE(FONT_5X7, 4);
+    show_text(img, msg, x, y, fg, bg, &st);
+}
+
+/* text_style works out how text in a font and layout scale is drawn, where TEXT_STYLE cannot */
+text_style_t text_style (font_t font, int scale) {
+    return (text_style_t)TEXT_STYLE(font, scale);
+}
+
+/* text_extent gives the area a string of len characters covers, including the gaps between them */
+void text_extent (const text_style_t *st, int len, int *width, int *height) {
+    *width = len * st->pitch;
+    *height = (st->pitch == 0) ? 0 : fonts[st->font].rows * st->pixel_scale;
+}
+
+/* show_string draws msg in a base font and scale factor as used in info_items */
+void show_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg, font_t font, int scale) {
+    text_style_t st = text_style(font, scale);
+    if (st.pitch != 0) show_text(img, msg, x, y, fg, bg, &st);
+}
+
+#if USE_BAND_RENDER
+/* show_band_item draws a retained text item into the band being rendered.  Unlike show_string it
+   does not take the image mutex: the band and core1's copy of the items are not shared. */
+void show_band_item (image_row_t *band, const text_item_t *it) {
+    if (it->style.pitch != 0) draw_text(band, it->text, it->x, it->y, it->fg, it->bg, &it->style);
+}
+#endif
+
+
+static bool same_place_and_style (const text_item_t *it, uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+    return it->valid && (it->x == x) && (it->y == y) && (it->fg == fg) && (it->bg == bg) &&
+           (it->style.font == st->font) && (it->style.scale == st->scale);
+}
+
+/* set_text_item records msg as the text now shown in a slot, marking dirty only the character
+   cells that differ from what was there (or the whole of the old and new text if anything
+   else has changed).  Any other item it overlaps is invalidated, since it has been drawn over.
+   The caller must hold the image mutex. */
+void set_text_item (text_item_t items[MAX_TEXT_ITEMS], int slot, 
+                    const char *msg, uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+    text_item_t *it = &items[slot];
+    int len = strlen(msg), w, h;
+    if (same_place_and_style(it, x, y, fg, bg, st)) {
+        int old_len = strlen(it->text);
+        int n = (len > old_len) ? len : old_len;
+        text_extent(st, 1, &w, &h);
+        for (int i = 0; i < n; ++i) {
+            char old_c = (i < old_len) ? it->text[i] : '\0';
+            char new_c = (i < len) ? msg[i] : '\0';
+            if (old_c != new_c) mark_dirty(x + (i * st->pitch), y, w, h);
+        }
+    } else {
+        if (it->valid) {
+            text_extent(&it->style, strlen(it->text), &w, &h);
+            mark_dirty(it->x, it->y, w, h);
+        }
+        text_extent(st, len, &w, &h);
+        mark_dirty(x, y, w, h);
     }
-    mutex_exit(img_mu);
+
+    text_extent(st, len, &w, &h);
+    rect_t drawn = {x, y, w, h};
+    for (int i = 0; i < MAX_TEXT_ITEMS; ++i) {
+        if ((i == slot) || !items[i].valid) continue;
+        int iw, ih;
+        text_extent(&items[i].style, strlen(items[i].text), &iw, &ih);
+        rect_t other = {items[i].x, items[i].y, iw, ih};
+        if (rects_touch(&drawn, &other)) items[i].valid = false;
+    }
+
+    it->valid = (len < TEXT_MAX);   // too long to remember means always redrawing it in full
+    strncpy(it->text, msg, TEXT_MAX - 1);
+    it->text[TEXT_MAX - 1] = '\0';
+    it->x = x;
+    it->y = y;
+    it->fg = fg;
+    it->bg = bg;
+    it->style = *st;
 }
 
-void show_40x56_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg) {
-    // clear background
-    int w = strlen(msg) * 46; // 6 pixel gap between chars
-    // printf("DEBUG: Msg: >>%s<< w: %d\n", msg, w);
+/* show_text_item draws msg for a text item, re-rasterising only the character cells that differ
+   from the text last drawn for it.  Cells beyond the end of a shorter string are cleared. */
+void show_text_item (image_t img, text_item_t items[MAX_TEXT_ITEMS], int slot, 
+                     char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+    if (st->pitch == 0) return;
+    const font_desc_t *f = &fonts[st->font];
+    text_item_t *it = &items[slot];
+    int len = strlen(msg);
+    int h = f->rows * st->pixel_scale;
     mutex_enter_blocking(img_mu);
-    show_block(img, x, y, w, 56, bg);
-    for (unsigned int ix = 0; ix < strlen(msg); ++ix) {
-        show_40x56_char(img, msg[ix], fg, x + (ix * 46), y);
+    if (same_place_and_style(it, x, y, fg, bg, st)) {
+        int old_len = strlen(it->text);
+        int n = (len > old_len) ? len : old_len;
+        for (int i = 0; i < n; ++i) {
+            char old_c = (i < old_len) ? it->text[i] : '\0';
+            char new_c = (i < len) ? msg[i] : '\0';
+            if (old_c == new_c) continue;
+            uint16_t cx = x + (i * st->pitch);
+            if (i < len) {
+                draw_cells(img, st, &msg[i], 1, fg, bg, cx, y);
+            } else {
+                show_block(img, cx, y, st->pitch, h, bg);
+            }
+        }
+    } else {
+        if (it->valid) {
+            // whatever was there before must not be left behind
+            int old_w, old_h;
+            text_extent(&it->style, strlen(it->text), &old_w, &old_h);
+            show_block(img, it->x, it->y, old_w, old_h, bg);
+        }
+        draw_cells(img, st, msg, len, fg, bg, x, y);
     }
+    if (!drawing_band) set_text_item(items, slot, msg, x, y, fg, bg, st);
     mutex_exit(img_mu);
-}
+}
\ No newline at end of file
@@ -12,19 +12,95 @@
 #include "image.h"
 #include "lcd.h"
 
-rgb_t string2rgb(const char *s);
+// Maximum number of separate dirty regions tracked before they are merged
+#define MAX_DIRTY_RECTS 8
+
+typedef struct {
+    uint16_t x, y;      // top-left corner
+    uint16_t w, h;      // width and height in pixels
+} rect_t;
+
+typedef enum { FONT_3X5, FONT_5X7 } font_t;
+
+// Glyph width and height of each base font in font pixels
+#define FONT_COLS(font) ((font) == FONT_3X5 ? 3 : 5)
+#define FONT_ROWS(font) ((font) == FONT_3X5 ? 5 : 7)
+#define CELL_MAX_WIDTH 48       // widest character cell (glyph and gap) of any text style, in screen pixels
+
+/* Every supported font/scale combination, as
+   STYLE(font, scale as given in the layout, pixel scale, pitch between characters, ...)
+   with any further arguments of TEXT_STYLES passed on to each.  Pixel scales must be powers of
+   two, and pitches even. */
+#define TEXT_STYLES(STYLE, ...) \
+    STYLE(FONT_3X5, 1, 1, 4, __VA_ARGS__)   /* 3x5,   1 pixel gap between chars */ \
+    STYLE(FONT_3X5, 2, 2, 8, __VA_ARGS__)   /* 6x10,  2 pixel gap between chars */ \
+    STYLE(FONT_5X7, 1, 1, 6, __VA_ARGS__)   /* 5x7,   1 pixel gap between chars */ \
+    STYLE(FONT_5X7, 2, 2, 14, __VA_ARGS__)  /* 10x14, 4 pixel gap between chars */ \
+    STYLE(FONT_5X7, 4, 8, 46, __VA_ARGS__)  /* 40x56, 6 pixel gap between chars */
+
+// Any 3x5 scale other than 1 is drawn as scale 2
+#define TEXT_STYLE_SCALE(font, scale) ((((font) == FONT_3X5) && ((scale) != 1)) ? 2 : (scale))
+#define TEXT_STYLE_IS(f, s, font, scale) (((font) == (f)) && (TEXT_STYLE_SCALE(font, scale) == (s)))
+#define TEXT_PIXEL_SCALE_IF(f, s, pixel_scale, pitch, font, scale) TEXT_STYLE_IS(f, s, font, scale) ? (pixel_scale) :
+#define TEXT_PITCH_IF(f, s, pixel_scale, pitch, font, scale) TEXT_STYLE_IS(f, s, font, scale) ? (pitch) :
+
+// How text in a font and layout scale is drawn; a pitch of 0 means it cannot be
+typedef struct {
+    uint8_t font;           // font_t
+    uint8_t scale;          // scale as given in the layout
+    uint8_t pixel_scale;    // each font pixel becomes a pixel_scale square
+    uint8_t pitch;          // glyph width plus the gap to the next character
+} text_style_t;
+
+// A text_style_t initialiser, worked out at build time for a constant font and scale
+#define TEXT_STYLE(font, scale) \
+    {font, scale, (TEXT_STYLES(TEXT_PIXEL_SCALE_IF, font, scale) 0), (TEXT_STYLES(TEXT_PITCH_IF, font, scale) 0)}
+
+// Text items - the info items plus the urgent message in the last slot
+#define MAX_TEXT_ITEMS 8
+#define URGENT_TEXT_SLOT (MAX_TEXT_ITEMS - 1)
+
+// Longest text an item holds (including the terminating NUL)
+#define TEXT_MAX 40
+
+// What was last drawn for a text item, so that only changed characters need redrawing
+typedef struct {
+    bool     valid;
+    char     text[TEXT_MAX];
+    uint16_t x, y;
+    colour_t fg, bg;
+    text_style_t style;
+} text_item_t;
+
+// Dirty region tracking - callers must hold the image mutex
+void mark_dirty (int x, int y, int width, int height);
+int  take_dirty_rects (rect_t rects[MAX_DIRTY_RECTS]);
 
 void graphics_init(mutex_t * image_mutex);
+void graphics_lock();
+void graphics_unlock();
 void clear_to_black (image_t img);
-// void show_3x5_char  (image_t img, unsigned char c, rgb_t fg, rgb_t bg, uint16_t x, uint16_t y);
-// void show_5x7_char  (image_t img, unsigned char c, rgb_t fg, rgb_t bg, uint16_t x, uint16_t y);
-// void show_6x10_char (image_t img, unsigned char c, rgb_t fg, rgb_t bg, uint16_t x, uint16_t y);
-// void show_10x14_char (image_t img, unsigned char c, rgb_t fg, rgb_t bg, uint16_t x, uint16_t y);
-// void show_40x56_char (image_t img, unsigned char c, rgb_t fg, uint16_t x, uint16_t y);
-void show_3x5_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg);
-void show_5x7_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg);
-void show_6x10_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg);
-void show_10x14_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg);
-void show_40x56_string (image_t img, char msg[], uint16_t x, uint16_t y, rgb_t fg, rgb_t bg);
+// show_block does not mark the image dirty; neither of these locks it
+void show_block (image_row_t *img, uint16_t x, uint16_t y, int width, int height, colour_t col);
+void show_line (image_t img, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, colour_t col);
+void show_3x5_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg);
+void show_5x7_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg);
+void show_6x10_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg);
+void show_10x14_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg);
+void show_40x56_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg);
+void show_string (image_t img, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg, font_t font, int scale);
+text_style_t text_style (font_t font, int scale);
+void text_extent (const text_style_t *st, int len, int *width, int *height);
+void show_text_item (image_t img, text_item_t items[MAX_TEXT_ITEMS], int slot, 
+                     char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st);
+void set_text_item (text_item_t items[MAX_TEXT_ITEMS], int slot, 
+                    const char *msg, uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st);
+
+#if USE_BAND_RENDER
+// Draw into a buffer holding only screen rows y0 .. y0+rows-1, without marking anything dirty
+void graphics_begin_band (int y0, int rows);
+void graphics_end_band ();
+void show_band_item (image_row_t *band, const text_item_t *it);     // takes no lock
+#endif
 
 #endif // DISPLAY_H
\ No newline at end of file
@@ -17,8 +17,29 @@ typedef struct {
     uint8_t b : 2;
 } rgb_t;
 
-extern const rgb_t BLACK, RED, GREEN, BLUE, WHITE, CYAN, MAGENTA, YELLOW;
+// The image holds 4-bit indices into a 16-entry palette, two pixels per byte
+#define PALETTE_SIZE 16
 
-typedef rgb_t image_t[LCD_WIDTH][LCD_HEIGHT];
+typedef uint8_t colour_t;
+
+// Palette indices of the named colours
+enum { BLACK, RED, GREEN, BLUE, WHITE, CYAN, MAGENTA, YELLOW };
+
+extern const rgb_t palette[PALETTE_SIZE];
+
+// Row-major, matching the order pixels are sent to the LCD: even x in the low nibble, odd x in the high
+typedef uint8_t image_row_t[LCD_WIDTH / 2];
+typedef image_row_t image_t[LCD_HEIGHT];
+
+// Routines that may be given a band of rows (see bands.h) rather than the whole image take image_row_t *
+static inline void image_set(image_row_t *img, int x, int y, colour_t c) {
+    uint8_t *p = &img[y][x >> 1];
+    if (x & 1) *p = (*p & 0x0f) | (c << 4);
+    else       *p = (*p & 0xf0) | c;
+}
+
+static inline colour_t image_get(const image_row_t *img, int x, int y) {
+    return (x & 1) ? (img[y][x >> 1] >> 4) : (img[y][x >> 1] & 0x0f);
+}
 
 #endif
\ No newline at end of file
@@ -9,50 +9,58 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "bands.h"
+#include "display_list.h"
+#include "json.h"
 #include "graphics.h"
 #include "lcd.h"
 #include "mqtt.h"
+#include "pico/cyw43_arch.h"
+#include "pico/time.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "sntp_clock.h"
 
 static image_t *ii_image;
-static bool showing_urgent;
-static char urgent_msg[MAX_URGENT_CHARS];
-
-#ifdef CLOCK1
-    const int INFO_ITEM_COUNT = 4;
-    info_item_t info_items[] = {
-        {"rgbmatrix/time_hhmmss", "", "", 1, 0, "YELLOW", "BLACK", "3x5", 2},
-        {"rgbmatrix/time_date", "", "", 2, 12, "MAGENTA", "BLACK", "5x7", 1},
-        {"rgbmatrix/music_temp", "", "C", 0, 22, "CYAN", "BLACK", "3x5", 2},
-        {"rgbmatrix/music_hum", "", "%", 42, 22, "BLUE", "BLACK", "3x5", 2}
-    };
-    info_item_t urgent_item = {URGENT_TOPIC, "", "", 0, 22, "RED", "BLACK", "3x5", 2};
-#endif
-#ifdef CLOCK2
-    const int INFO_ITEM_COUNT = 4;
-    const info_item_t info_items[] = {
-        {"rgbmatrix/time_hhmm", "", "", 134, 10, "YELLOW", "BLACK", "5x7", 4},
-        // {"rgbmatrix/time_hhmmss", "", "", 100, 8, "YELLOW", "BLACK", "5x7", 4},
-        {"rgbmatrix/time_date", "", "", 10, 126, "MAGENTA", "BLACK", "5x7", 4},
-        {"rgbmatrix/Pauls_Studio/temperature", "", "C", 8, 250, "CYAN", "BLACK", "5x7", 4},
-        {"rgbmatrix/outside_temp", "", "C", 330, 250, "GREEN", "BLACK", "5x7", 4}
-    };
-    const info_item_t urgent_item = {URGENT_TOPIC, "", "", 0, 250, "RED", "BLACK", "5x7", 4};
-#endif
-#ifdef INFOPANEL1
-    const int INFO_ITEM_COUNT = 5;
-    info_item_t info_items[] = {
-        {"rgbmatrix/time_hhmmss", "", "", 1, 0, "YELLOW", "BLACK", "3x5", 2},
-        {"rgbmatrix/time_date", "", "", 2, 12, "MAGENTA", "BLACK", "5x7", 1},
-        {"rgbmatrix/office_temp", "", "C", 9, 22, "CYAN", "BLACK", "3x5", 2},
-        {"rgbmatrix/outside_temp", "/ ", "", 42, 22, "BLUE", "BLACK", "3x5", 2},
-        {"rgbmatix/gbpeur", "", "", 8, 39, "MAGENTA", "BLACK", "3x5", 1}
-    };
-    info_item_t urgent_item = {URGENT_TOPIC, "", "", 0, 44, "RED", "BLACK", "5x7", 2};
+#if !USE_BAND_RENDER && !USE_DISPLAY_LIST
+static text_item_t rendered[MAX_TEXT_ITEMS];   // what each item last drew
 #endif
+// Latest text for each info item not yet drawn - only the newest message on a topic is ever rendered
+static char pending_text[URGENT_TEXT_SLOT][TEXT_MAX];
+static uint32_t pending_bits;
+static uint32_t pending_since_us;   // when the oldest update not yet drawn arrived - the LCD latency runs from here
+
+// Items sharing a topic are chained from the first, which is the one the topic is routed to
+static int next_on_topic[URGENT_TEXT_SLOT];
+static uint32_t topic_has_fields;   // bit set for the first item of a topic when any item on it has a field
+static bool render_scheduled;
+static info_stats_t stats;
+
+static bool showing_urgent;
+static char urgent_msg[MAX_URGENT_CHARS + 1];
+
+#define LAYOUT_ITEM INFO_ITEM
+
+const info_item_t info_items[] = { LAYOUT_ITEMS };
+const int INFO_ITEM_COUNT = sizeof(info_items) / sizeof(info_items[0]);
+static const info_item_t urgent_item = URGENT_ITEM;
+
+#undef LAYOUT_ITEM
 
 void info_setup(image_t *image) {
     ii_image = image;
     showing_urgent = false;
+    for (int i = 0; i < INFO_ITEM_COUNT; ++i) {
+        int first = 0;
+        while (strcmp(info_items[first].topic, info_items[i].topic) != 0) ++first;
+        next_on_topic[i] = -1;
+        if (first < i) {
+            int last = first;
+            while (next_on_topic[last] >= 0) last = next_on_topic[last];
+            next_on_topic[last] = i;
+        }
+        if (info_items[i].field_len > 0) topic_has_fields |= 1u << first;
+    }
 }
 
 uint32_t getTotalHeap(void) {
@@ -65,15 +73,27 @@ uint32_t getFreeHeap(void) {
    return getTotalHeap() - m.uordblks;
 }
 
+/* draw_string draws directly into the image, queues it for core1, or (with no image) retains it */
+static void draw_string(int slot, char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+#if USE_BAND_RENDER
+    band_set_item(slot, msg, x, y, fg, bg, st);
+#elif USE_DISPLAY_LIST
+    dl_text(slot, msg, x, y, fg, bg, st);
+#else
+    show_text_item(*ii_image, rendered, slot, msg, x, y, fg, bg, st);
+#endif
+}
+
 void show_urgent() {
     if (showing_urgent) {
-        show_40x56_string(*ii_image, 
-                        urgent_msg, 
-                        urgent_item.x, 
-                        urgent_item.y, 
-                        string2rgb(urgent_item.fg), 
-                        string2rgb(urgent_item.bg)
-                        );
+        draw_string(URGENT_TEXT_SLOT,
+                    urgent_msg, 
+                    urgent_item.x, 
+                    urgent_item.y, 
+                    urgent_item.fg, 
+                    urgent_item.bg,
+                    &urgent_item.style
+                    );
         lcd_invalidate();
     }
 }
@@ -82,102 +102,213 @@ void show_urgent() {
    It is intended to be used for the blink effect. */
 void hide_urgent() {
     if (showing_urgent) {
-        show_40x56_string(*ii_image, 
-                urgent_msg, 
-                urgent_item.x, 
-                urgent_item.y, 
-                BLACK, 
-                BLACK
-                );
+        draw_string(URGENT_TEXT_SLOT,
+                    urgent_msg, 
+                    urgent_item.x, 
+                    urgent_item.y, 
+                    BLACK, 
+                    BLACK,
+                    &urgent_item.style
+                    );
         lcd_invalidate();
     }
 }
 
+/* render_tick draws the latest text of every item updated since the last tick, as one frame.
+   It runs in the same (lwIP) context as the MQTT callbacks that fill pending_text. */
+static void render_tick(__attribute__((unused)) async_context_t *context, 
+                        __attribute__((unused)) async_at_time_worker_t *worker) {
+    render_scheduled = false;
+    if (pending_bits == 0) return;
+    for (int id = 0; id < INFO_ITEM_COUNT; ++id) {
+        if (pending_bits & (1u << id)) {
+            const info_item_t *d = &info_items[id];
+            draw_string(id, pending_text[id], d->x, d->y, d->fg, d->bg, &d->style);
+        }
+    }
+    pending_bits = 0;
+    ++stats.frames;
+    lcd_invalidate_since(pending_since_us);
+}
+
+static async_at_time_worker_t render_worker = { .do_work = render_tick };
+
+/* info_render_now draws pending items at once, for updates that are already timed (the clock) */
+void info_render_now() {
+    if (render_scheduled) {
+        async_context_remove_at_time_worker(cyw43_arch_async_context(), &render_worker);
+    }
+    render_tick(NULL, NULL);
+}
+
+void info_get_stats(info_stats_t *s) {
+    *s = stats;
+}
+
+/* set_pending stores the text an info item is to show next */
+static void set_pending(int id, const char *data, int len) {
+    const info_item_t *d = &info_items[id];
+    char *info = pending_text[id];
+    int n = d->prefix_len;
+    if (n + len + d->suffix_len >= TEXT_MAX) {
+        printf("WARNING: Payload too long for info item %d - truncating\n", id);
+        len = TEXT_MAX - 1 - n - d->suffix_len;
+        if (len < 0) len = 0;
+    }
+    memcpy(info, d->prefix, n);
+    memcpy(info + n, data, len);
+    n += len;
+    memcpy(info + n, d->suffix, d->suffix_len);
+    n += d->suffix_len;
+    info[n] = '\0';
+    if (pending_bits & (1u << id)) ++stats.coalesced;   // replaces a value never drawn
+    pending_bits |= 1u << id;
+}
+
+static void schedule_render() {
+    if ((pending_bits != 0) && !render_scheduled) {
+        render_scheduled = async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), 
+                                                                  &render_worker, INFO_RENDER_INTERVAL_MS);
+    }
+}
+
+/* uncover_items redraws the info items that the urgent message was drawn over, once it has gone */
+static void uncover_items() {
+    int uw, uh, w, h;
+    text_extent(&urgent_item.style, strlen(urgent_msg), &uw, &uh);
+    for (int id = 0; id < INFO_ITEM_COUNT; ++id) {
+        const info_item_t *d = &info_items[id];
+        if (pending_text[id][0] == '\0') continue;    // nothing received yet
+        text_extent(&d->style, strlen(pending_text[id]), &w, &h);
+        if ((d->x <= urgent_item.x + uw) && (urgent_item.x <= d->x + w) &&
+            (d->y <= urgent_item.y + uh) && (urgent_item.y <= d->y + h)) {
+            if (pending_bits == 0) pending_since_us = time_us_32();
+            pending_bits |= 1u << id;
+        }
+    }
+    schedule_render();
+}
+
+/* json_field hands a JSON member to every item on the topic that shows it */
+static void json_field(const char *path, int path_len, const char *value, int value_len, void *arg) {
+    if (path_len == 0) return;      // a payload that is not an object - the whole-payload items have it
+    for (int id = *(int *)arg; id >= 0; id = next_on_topic[id]) {
+        const info_item_t *d = &info_items[id];
+        if ((d->field_len == path_len) && (memcmp(d->field, path, path_len) == 0)) set_pending(id, value, value_len);
+    }
+}
+
 void show_data(int id, const char *data, int len) {
-    if (id < INFO_ITEM_COUNT) { // handle msg on a subscribed topic
-        char info[40] = "";
-        if (strlen(info_items[id].prefix) > 0) strcat(info, info_items[id].prefix);
-        strncat(info, data, len);
-        if (strlen(info_items[id].suffix) > 0) strcat(info, info_items[id].suffix);
-        if (strcmp(info_items[id].font, "3x5") == 0) {
-            if (info_items[id].scale == 1) {
-                show_3x5_string(*ii_image, 
-                                info, 
-                                info_items[id].x, 
-                                info_items[id].y, 
-                                string2rgb(info_items[id].fg), 
-                                string2rgb(info_items[id].bg)
-                            );
-            } else {
-                show_6x10_string(*ii_image, 
-                                info, 
-                                info_items[id].x, 
-                                info_items[id].y, 
-                                string2rgb(info_items[id].fg), 
-                                string2rgb(info_items[id].bg)
-                                );
-            }
-        } else {
-            switch (info_items[id].scale) {
-                case 1:
-                    show_5x7_string(*ii_image, 
-                                info, 
-                                info_items[id].x, 
-                                info_items[id].y, 
-                                string2rgb(info_items[id].fg), 
-                                string2rgb(info_items[id].bg)
-                                );
-                    break;
-                case 2:
-                    show_10x14_string(*ii_image, 
-                                info, 
-                                info_items[id].x, 
-                                info_items[id].y, 
-                                string2rgb(info_items[id].fg), 
-                                string2rgb(info_items[id].bg)
-                                );
-                    break;
-                case 4:
-                    show_40x56_string(*ii_image, 
-                                info, 
-                                info_items[id].x, 
-                                info_items[id].y, 
-                                string2rgb(info_items[id].fg), 
-                                string2rgb(info_items[id].bg)
-                                );
-            }
+    if (id >= 0 && id < INFO_ITEM_COUNT) { // handle msg on a subscribed topic - id is its first item
+        ++stats.received;
+        uint32_t arrived_us = time_us_32();
+        bool idle = (pending_bits == 0);
+        if (topic_has_fields & (1u << id)) {
+            if (!json_scan(data, len, json_field, &id)) printf("WARNING: Malformed JSON for info item %d\n", id);
         }
-        lcd_invalidate();
+        for (int i = id; i >= 0; i = next_on_topic[i]) {
+            if (info_items[i].field_len == 0) set_pending(i, data, len);
+        }
+        if (idle && (pending_bits != 0)) pending_since_us = arrived_us;
+        schedule_render();
         return;
     } 
     if (id == ID_CONTROL) {
-        if (strcmp(data, "Off") == 0) {
+        char cmd[CONTROL_PAYLOAD_MAX + 1];
+        if (len > CONTROL_PAYLOAD_MAX) len = CONTROL_PAYLOAD_MAX;
+        memcpy(cmd, data, len);
+        cmd[len] = '\0';
+        if (strcmp(cmd, "Off") == 0) {
             // set_blank_display(true);
             lcd_off();
         }
-        if (strcmp(data, "On") == 0) {
+        if (strcmp(cmd, "On") == 0) {
             // set_blank_display(false);
             lcd_on();
         }
-        if (strcmp(data, "Darker") == 0) {
+        if (strcmp(cmd, "Darker") == 0) {
             lcd_darken();
         }
-        if (strcmp(data, "Lighter") == 0) {
+        if (strcmp(cmd, "Lighter") == 0) {
             lcd_brighten();
         }
-        if (strcmp(data, "Memory") == 0) {
+        if (strcmp(cmd, "Memory") == 0) {
             printf("INFO: Free memory: %lu\n", getFreeHeap());
         }
+        if (strcmp(cmd, "Stats") == 0) {
+            lcd_stats_t ls;
+            lcd_get_stats(&ls);
+            printf("INFO: LCD generations: %lu frames: %lu regions: %lu bytes: %lu\n",
+                   ls.generations, ls.frames_pushed, ls.rects_pushed, ls.bytes_pushed);
+#if USE_DISPLAY_LIST
+            dl_stats_t ds;
+            dl_get_stats(&ds);
+            printf("INFO: Display list queued: %lu rendered: %lu dropped: %lu high water: %lu\n",
+                   ds.queued, ds.rendered, ds.dropped, ds.high_water);
+#endif
+            info_stats_t is;
+            info_get_stats(&is);
+            printf("INFO: Info messages received: %lu coalesced: %lu frames rendered: %lu\n",
+                   is.received, is.coalesced, is.frames);
+#if USE_LOCAL_CLOCK
+            clock_stats_t cs;
+            clock_get_stats(&cs);
+            printf("INFO: Clock syncs: %lu last error us: %ld max: %ld rate ppm: %ld ticks: %lu\n",
+                   cs.syncs, cs.last_error_us, cs.max_error_us, cs.rate_ppm, cs.ticks);
+#endif
+            for (int j = 0; j < sched_job_count(); ++j) {
+                sched_job_stats_t js;
+                sched_get_job_stats(j, &js);
+                printf("INFO: Job %s period ms: %lu runs: %lu overruns: %lu max us: %lu\n",
+                       js.name, js.period_ms, js.runs, js.overruns, js.max_run_us);
+            }
+            sensor_stats_t ss;
+            sensors_get_stats(&ss);
+            printf("INFO: DHT reads: %lu failures: %lu timeouts: %lu published: %lu suppressed: %lu\n",
+                   ss.reads, ss.failures, ss.timeouts, ss.published, ss.suppressed);
+            if (ss.reads > ss.failures) {
+                printf("INFO: DHT latency us last: %lu avg: %lu max: %lu\n", ss.latency_us_last,
+                       (uint32_t)(ss.latency_us_total / (ss.reads - ss.failures)), ss.latency_us_max);
+            }
+            mqtt_rx_stats_t ms;
+            mqtt_get_rx_stats(&ms);
+            printf("INFO: MQTT payloads: %lu reassembled: %lu truncated: %lu overflows: %lu\n",
+                   ms.payloads, ms.reassembled, ms.truncated, ms.overflows);
+            mqtt_pub_stats_t mps;
+            mqtt_get_pub_stats(&mps);
+            printf("INFO: MQTT publishes queued: %lu coalesced: %lu sent: %lu retried: %lu dropped: %lu in flight: %lu\n",
+                   mps.queued, mps.coalesced, mps.sent, mps.retried, mps.dropped, mps.in_flight);
+            printf("INFO: MQTT publish cycle max us: %lu\n", mps.cycle_us_max);
+            mqtt_link_stats_t mls;
+            mqtt_get_link_stats(&mls);
+            printf("INFO: MQTT attempts: %lu connects: %lu failures: %lu disconnects: %lu\n",
+                   mls.attempts, mls.connects, mls.failures, mls.disconnects);
+            if (mls.connects > 0) {
+                printf("INFO: MQTT reconnect ms last: %lu avg: %lu max: %lu\n",
+                       mls.latency_ms_last, (uint32_t)(mls.latency_ms_total / mls.connects), mls.latency_ms_max);
+            }
+            if (ls.latency_samples > 0) {
+                printf("INFO: LCD latency us min: %lu avg: %lu max: %lu\n",
+                       ls.latency_us_min, (uint32_t)(ls.latency_us_total / ls.latency_samples), ls.latency_us_max);
+            }
+        }
         return;
     }
     if (id == ID_URGENT) {
-        if (strlen(data) > 0) {
+        if (len > 0) {
             showing_urgent = true;
-            strncpy(urgent_msg, data, MAX_URGENT_CHARS);
+            if (len > MAX_URGENT_CHARS) len = MAX_URGENT_CHARS;
+            memcpy(urgent_msg, data, len);
+            urgent_msg[len] = '\0';
             show_urgent();
-        } else {
+        } else if (showing_urgent) {
             hide_urgent();            
             showing_urgent = false;
+#if USE_BAND_RENDER
+            // the slot would otherwise still be rendered, black on black, over the items beneath
+            band_clear_item(URGENT_TEXT_SLOT);
+#endif
+            uncover_items();
         }
         return;
     }
@@ -7,27 +7,48 @@
 #define INFO_ITEMS_H
 
 #include "graphics.h"
+#include "layout.h"
 
-#define MAX_URGENT_CHARS 12
-
+/* An info item as compiled from the selected layout in layout.h, with everything needed to
+   render a message resolved at build time */
 typedef struct {
-    char topic[64];     // full MQTT topic for this item
-    char prefix[16];    // string to display before item
-    char suffix[16];    // string to display after item
-    int x;              // left x ordinate to start drawing
-    int y;              // top y ordinate to start drawing
-    char fg[12];        // foreground colour name
-    char bg[12];        // background colour name    
-    char font[12];      // font name - only "3x5" or "5x7"
-    int scale;          // scale factor for font - only 1 or 2 supported ATM
+    const char *topic;      // full MQTT topic for this item
+    const char *field;      // dotted path of the JSON member shown, or "" for the whole payload
+    const char *prefix;     // string to display before item
+    const char *suffix;     // string to display after item
+    uint8_t field_len;
+    uint8_t prefix_len;
+    uint8_t suffix_len;
+    uint16_t x;             // left x ordinate to start drawing
+    uint16_t y;             // top y ordinate to start drawing
+    colour_t fg;
+    colour_t bg;
+    text_style_t style;     // font and scale factor, with how they are drawn - see TEXT_STYLES in graphics.h
+    uint8_t max_chars;      // longest value expected
 } info_item_t;
 
+// An info_item_t initialiser from a LAYOUT_ITEM in layout.h
+#define INFO_ITEM(topic, field, prefix, suffix, x, y, fg, bg, font, scale, max_chars) \
+    {topic, field, prefix, suffix, sizeof(field) - 1, sizeof(prefix) - 1, sizeof(suffix) - 1, x, y, fg, bg, \
+     TEXT_STYLE(font, scale), max_chars}
+
+// Messages for info items are held and drawn together at most this often
+#define INFO_RENDER_INTERVAL_MS LCD_MIN_FRAME_INTERVAL_MS
+
+typedef struct {
+    uint32_t received;      // info item messages received
+    uint32_t coalesced;     // ... overwritten by a newer message before being drawn
+    uint32_t frames;        // render ticks that drew at least one item
+} info_stats_t;
+
 extern const int INFO_ITEM_COUNT;
 
 extern const info_item_t info_items[];
 
 void info_setup(image_t *image);
-void show_data(int ix, const char *data, int len);
+void show_data(int ix, const char *data, int len);  // data need not be NUL-terminated
+void info_get_stats(info_stats_t *stats);
+void info_render_now();
 void show_urgent();
 void hide_urgent();
 
@@ -0,0 +1,131 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "json.h"
+
+#include <string.h>
+
+/* A minimal single-pass JSON scanner.  Nothing is allocated and values are not copied - the
+   found() callback is given pointers into the payload.  Members of arrays are skipped. */
+
+typedef struct {
+    const char *p;
+    const char *end;
+    char path[JSON_PATH_MAX];
+    json_found_t found;
+    void *arg;
+} scanner_t;
+
+static bool scan_value(scanner_t *s, int path_len, int depth);
+
+static void skip_space(scanner_t *s) {
+    while ((s->p < s->end) && ((*s->p == ' ') || (*s->p == '\t') || (*s->p == '\n') || (*s->p == '\r'))) ++s->p;
+}
+
+static bool at(scanner_t *s, char c) {
+    skip_space(s);
+    return (s->p < s->end) && (*s->p == c);
+}
+
+static bool scan_string(scanner_t *s, const char **start, int *len) {
+    if (!at(s, '"')) return false;
+    *start = ++s->p;
+    while ((s->p < s->end) && (*s->p != '"')) {
+        if (*s->p == '\\') ++s->p;
+        ++s->p;
+    }
+    if (s->p >= s->end) return false;
+    *len = s->p++ - *start;
+    return true;
+}
+
+/* scan_object reads the members of an object, extending the path with each name.
+   A path_len of -1 means the path has overflowed and nothing below here is reported. */
+static bool scan_object(scanner_t *s, int path_len, int depth) {
+    ++s->p;     // '{'
+    if (at(s, '}')) {
+        ++s->p;
+        return true;
+    }
+    while (true) {
+        const char *name;
+        int name_len;
+        if (!scan_string(s, &name, &name_len)) return false;
+        int n = path_len;
+        if (n > 0) s->path[n++] = '.';
+        if ((n < 0) || (n + name_len >= JSON_PATH_MAX)) {
+            n = -1;
+        } else {
+            memcpy(&s->path[n], name, name_len);
+            n += name_len;
+        }
+        if (!at(s, ':')) return false;
+        ++s->p;
+        if (!scan_value(s, n, depth + 1)) return false;
+        if (at(s, ',')) {
+            ++s->p;
+            continue;
+        }
+        if (at(s, '}')) {
+            ++s->p;
+            return true;
+        }
+        return false;
+    }
+}
+
+static bool scan_array(scanner_t *s, int depth) {
+    ++s->p;     // '['
+    if (at(s, ']')) {
+        ++s->p;
+        return true;
+    }
+    while (true) {
+        if (!scan_value(s, -1, depth + 1)) return false;
+        if (at(s, ',')) {
+            ++s->p;
+            continue;
+        }
+        if (at(s, ']')) {
+            ++s->p;
+            return true;
+        }
+        return false;
+    }
+}
+
+static bool scan_value(scanner_t *s, int path_len, int depth) {
+    if (depth > JSON_MAX_DEPTH) return false;
+    skip_space(s);
+    if (s->p >= s->end) return false;
+    if (*s->p == '{') return scan_object(s, path_len, depth);
+    if (*s->p == '[') return scan_array(s, depth);
+    const char *value = s->p;
+    int value_len;
+    if (*s->p == '"') {
+        if (!scan_string(s, &value, &value_len)) return false;
+    } else {
+        // number, true, false or null
+        while ((s->p < s->end) && (*s->p != ',') && (*s->p != '}') && (*s->p != ']') &&
+               (*s->p != ' ') && (*s->p != '\t') && (*s->p != '\n') && (*s->p != '\r')) ++s->p;
+        value_len = s->p - value;
+        if (value_len == 0) return false;
+    }
+    if (path_len >= 0) s->found(s->path, path_len, value, value_len, s->arg);
+    return true;
+}
+
+/* json_scan calls found() for every scalar member of the JSON object in json[0..len-1],
+   returning false if it turns out to be malformed (members before the error are still reported) */
+bool json_scan(const char *json, int len, json_found_t found, void *arg) {
+    scanner_t s;
+    s.p = json;
+    s.end = json + len;
+    s.found = found;
+    s.arg = arg;
+    if (!scan_value(&s, 0, 0)) return false;
+    skip_space(&s);
+    return s.p == s.end;
+}
@@ -0,0 +1,21 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+
+// Longest dotted member path reported, and deepest nesting accepted
+#define JSON_PATH_MAX 64
+#define JSON_MAX_DEPTH 8
+
+/* Called for each scalar member found.  path is the dotted member name (not NUL-terminated), and
+   value its raw text - strings without their quotes, escapes left as they are. */
+typedef void (*json_found_t)(const char *path, int path_len, const char *value, int value_len, void *arg);
+
+bool json_scan(const char *json, int len, json_found_t found, void *arg);
+
+#endif
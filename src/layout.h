@@ -0,0 +1,69 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "graphics.h"
+#include "sntp_clock.h"
+
+// Define ONE of the following (see also mqtt.h)
+// #define CLOCK1
+#define CLOCK2
+// #define INFOPANEL1
+
+// Topics of the time and date items
+#if USE_LOCAL_CLOCK
+    #define TIME_HHMMSS_TOPIC CLOCK_HHMMSS
+    #define TIME_HHMM_TOPIC   CLOCK_HHMM
+    #define TIME_DATE_TOPIC   CLOCK_DATE
+#else
+    #define TIME_HHMMSS_TOPIC "rgbmatrix/time_hhmmss"
+    #define TIME_HHMM_TOPIC   "rgbmatrix/time_hhmm"
+    #define TIME_DATE_TOPIC   "rgbmatrix/time_date"
+#endif
+
+// Longest urgent message shown - ten 40x56 characters fill the screen width
+#define MAX_URGENT_CHARS 10
+
+/* Each layout lists its info items, separated by commas, as
+     LAYOUT_ITEM(topic, field, prefix, suffix, x, y, fg, bg, font, scale, max_chars)
+   where field is "" to show the whole payload, or the dotted path of a member of a JSON payload,
+   e.g. LAYOUT_ITEM("zigbee2mqtt/lounge", "temperature", ...) and LAYOUT_ITEM("zigbee2mqtt/lounge", "humidity", ...)
+   show two fields of one message.  max_chars is the longest value expected, not counting the prefix and
+   suffix, and URGENT_ITEM gives the position and style of the urgent message.
+   layout_check.cpp fails the build if an item can reach off screen or overlap another one. */
+
+#ifdef CLOCK1
+    #define LAYOUT_ITEMS \
+        LAYOUT_ITEM(TIME_HHMMSS_TOPIC, "", "", "", 1, 0, YELLOW, BLACK, FONT_3X5, 2, 8), \
+        LAYOUT_ITEM(TIME_DATE_TOPIC, "", "", "", 2, 12, MAGENTA, BLACK, FONT_5X7, 1, 10), \
+        LAYOUT_ITEM("rgbmatrix/music_temp", "", "", "C", 0, 22, CYAN, BLACK, FONT_3X5, 2, 4), \
+        LAYOUT_ITEM("rgbmatrix/music_hum", "", "", "%", 42, 22, BLUE, BLACK, FONT_3X5, 2, 3)
+    #define URGENT_ITEM \
+        LAYOUT_ITEM(URGENT_TOPIC, "", "", "", 0, 22, RED, BLACK, FONT_5X7, 4, MAX_URGENT_CHARS)
+#endif
+#ifdef CLOCK2
+    /* alternatively LAYOUT_ITEM(TIME_HHMMSS_TOPIC, "", "", "", 100, 8, YELLOW, BLACK, FONT_5X7, 4, 8) */
+    #define LAYOUT_ITEMS \
+        LAYOUT_ITEM(TIME_HHMM_TOPIC, "", "", "", 134, 10, YELLOW, BLACK, FONT_5X7, 4, 5), \
+        LAYOUT_ITEM(TIME_DATE_TOPIC, "", "", "", 10, 126, MAGENTA, BLACK, FONT_5X7, 4, 10), \
+        LAYOUT_ITEM("rgbmatrix/Pauls_Studio/temperature", "", "", "C", 8, 250, CYAN, BLACK, FONT_5X7, 4, 4), \
+        LAYOUT_ITEM("rgbmatrix/outside_temp", "", "", "C", 330, 250, GREEN, BLACK, FONT_5X7, 4, 2)
+    #define URGENT_ITEM \
+        LAYOUT_ITEM(URGENT_TOPIC, "", "", "", 0, 250, RED, BLACK, FONT_5X7, 4, MAX_URGENT_CHARS)
+#endif
+#ifdef INFOPANEL1
+    #define LAYOUT_ITEMS \
+        LAYOUT_ITEM(TIME_HHMMSS_TOPIC, "", "", "", 1, 0, YELLOW, BLACK, FONT_3X5, 2, 8), \
+        LAYOUT_ITEM(TIME_DATE_TOPIC, "", "", "", 2, 12, MAGENTA, BLACK, FONT_5X7, 1, 10), \
+        LAYOUT_ITEM("rgbmatrix/office_temp", "", "", "C", 9, 22, CYAN, BLACK, FONT_3X5, 2, 3), \
+        LAYOUT_ITEM("rgbmatrix/outside_temp", "", "/ ", "", 42, 22, BLUE, BLACK, FONT_3X5, 2, 4), \
+        LAYOUT_ITEM("rgbmatix/gbpeur", "", "", "", 8, 39, MAGENTA, BLACK, FONT_3X5, 1, 6)
+    #define URGENT_ITEM \
+        LAYOUT_ITEM(URGENT_TOPIC, "", "", "", 0, 44, RED, BLACK, FONT_5X7, 4, MAX_URGENT_CHARS)
+#endif
+
+#endif
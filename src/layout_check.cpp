@@ -0,0 +1,70 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/* layout_check.cpp generates no code.  It works out at compile time the area each item of the
+   selected layout (see layout.h) can cover, and stops the build if one would be drawn off screen,
+   on top of another item, or in a font/scale that graphics.c cannot draw. */
+
+#include <cstddef>
+
+#include "layout.h"
+
+namespace {
+
+struct extent_t {
+    int x, y, w, h;
+    int chars;
+    bool drawable;
+};
+
+// Same rules as TEXT_STYLE() and text_extent() in graphics.h and graphics.c
+constexpr extent_t extent(int x, int y, int font, int scale, int chars) {
+    int pixel_scale = TEXT_STYLES(TEXT_PIXEL_SCALE_IF, font, scale) 0;
+    int pitch = TEXT_STYLES(TEXT_PITCH_IF, font, scale) 0;
+    if (pitch == 0) return {x, y, 0, 0, chars, false};
+    return {x, y, chars * pitch, FONT_ROWS(font) * pixel_scale, chars, true};
+}
+
+#define LAYOUT_ITEM(topic, field, prefix, suffix, x, y, fg, bg, font, scale, max_chars) \
+    extent(x, y, font, scale, (int)(sizeof(prefix) - 1 + (max_chars) + sizeof(suffix) - 1))
+
+constexpr extent_t items[] = { LAYOUT_ITEMS };
+constexpr extent_t urgent = URGENT_ITEM;
+
+#undef LAYOUT_ITEM
+
+constexpr std::size_t item_count = sizeof(items) / sizeof(items[0]);
+
+constexpr bool fits(const extent_t &e) {
+    return e.drawable && (e.chars < TEXT_MAX) &&
+           (e.x >= 0) && (e.y >= 0) && (e.x + e.w <= LCD_WIDTH) && (e.y + e.h <= LCD_HEIGHT);
+}
+
+constexpr bool overlap(const extent_t &a, const extent_t &b) {
+    return (a.x < b.x + b.w) && (b.x < a.x + a.w) && (a.y < b.y + b.h) && (b.y < a.y + a.h);
+}
+
+constexpr bool all_fit() {
+    for (const extent_t &e : items) {
+        if (!fits(e)) return false;
+    }
+    return fits(urgent);
+}
+
+// The urgent message deliberately covers other items, so it is not checked for overlaps
+constexpr bool none_overlap() {
+    for (std::size_t i = 0; i < item_count; ++i) {
+        for (std::size_t j = i + 1; j < item_count; ++j) {
+            if (overlap(items[i], items[j])) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(item_count <= URGENT_TEXT_SLOT, "layout.h: too many info items for MAX_TEXT_ITEMS");
+static_assert(all_fit(), "layout.h: an item has an unsupported font/scale, is too long, or reaches off screen");
+static_assert(none_overlap(), "layout.h: two info items can overlap at their longest");
+
+}
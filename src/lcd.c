@@ -9,22 +9,62 @@
 #include <stdlib.h>
 
 #include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "hardware/pio.h"
 #include "hardware/pwm.h"
+#include "hardware/sync.h"
 #include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "pico/sync.h"
 
+#include "bands.h"
+#include "display_list.h"
 #include "lcd.h"
 #include "lcd.pio.h"
+#include "lcd_rgb.pio.h"
 
 volatile bool rotate = LCD_ROTATE;
-volatile int dirty;
+volatile uint32_t frame_gen;  // bumped by core0 whenever the image has changed
+uint32_t pushed_gen;          // last generation core1 has sent to the LCD (core1 only)
+volatile uint32_t taken_gen;  // generation core1 most recently started sending
+volatile uint32_t oldest_submit_us; // when the oldest generation not yet taken by core1 was published
+lcd_stats_t stats;
 int brightness = BRIGHTNESS_DEFAULT;
 bool rotated;
+#if !USE_BAND_RENDER
 image_t disp_image;
+#endif
 mutex_t * img_mutex;
 
+#if LCD_SNAPSHOT_BYTES < (LCD_WIDTH * 3)
+#error "LCD_SNAPSHOT_BYTES must hold at least one full display row"
+#endif
+
+// Pixels packed 8 per FIFO word for the lcd_rgb program
+#define PIO_RGB_PIXELS_PER_WORD 8
+
+#if LCD_USE_PIO_RGB
+#if (LCD_WIDTH % PIO_RGB_PIXELS_PER_WORD) != 0
+#error "LCD_USE_PIO_RGB needs LCD_WIDTH to be a whole number of FIFO words"
+#endif
+// Palette entries reduced to the B, G, R colour bits the lcd_rgb program expands
+static uint8_t palette_bits[PALETTE_SIZE];
+#else
+// Palette entries expanded to the three bytes per pixel the LCD expects (B, G, R)
+static uint8_t palette_wire[PALETTE_SIZE][3];
+#endif
+
+// Region snapshots in wire format - core1 fills one while the other is being sent
+static uint32_t snap_buf[2][LCD_SNAPSHOT_BYTES / 4];
+
+#if LCD_USE_DMA
+static int lcd_dma_chan;
+#if LCD_USE_PIO_RGB
+static int lcd_rgb_dma_chan;
+#endif
+#endif
+
 void lcd_pio_init() {
 
   uint offset = pio_add_program(LCD_PIO, &lcd_program);
@@ -44,15 +84,104 @@ void lcd_pio_init() {
   pio_sm_set_enabled(LCD_PIO, LCD_PIO_SM, true);
 }
 
-void lcd_pio_set_dc(bool dc) {
-  // Wait until the PIO stalls (meaning it has finished sending)
-  uint32_t sm_stall_mask = 1u << (LCD_PIO_SM + PIO_FDEBUG_TXSTALL_LSB);
+#if LCD_USE_PIO_RGB
+// Must follow lcd_pio_init(), which sets up the shared pins
+void lcd_rgb_pio_init() {
+  uint offset = pio_add_program(LCD_PIO, &lcd_rgb_program);
+  pio_sm_config c = lcd_rgb_program_get_default_config(offset);
+  sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+  sm_config_set_out_shift(&c, false, true, PIO_RGB_PIXELS_PER_WORD * 3);
+  sm_config_set_out_pins(&c, LCD_PIN_MOSI, 1);
+  sm_config_set_set_pins(&c, LCD_PIN_MOSI, 1);
+  sm_config_set_sideset_pins(&c, LCD_PIN_CLK);
+  sm_config_set_clkdiv(&c, LCD_PIO_CLKDIV_CMD);
+
+  // Left disabled - only one of the two state machines drives the pins at a time
+  pio_sm_init(LCD_PIO, LCD_PIO_RGB_SM, offset, &c);
+}
+#endif
+
+#if LCD_USE_DMA
+// The DMA IRQ only exists to wake core1 from __wfe() when a transfer completes
+void lcd_dma_irq_handler() {
+  dma_channel_acknowledge_irq1(lcd_dma_chan);
+#if LCD_USE_PIO_RGB
+  dma_channel_acknowledge_irq1(lcd_rgb_dma_chan);
+#endif
+}
+
+static int lcd_dma_channel_init(uint sm, enum dma_channel_transfer_size size) {
+  int chan = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(chan);
+  channel_config_set_transfer_data_size(&c, size);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(LCD_PIO, sm, true));
+  dma_channel_configure(chan, &c, &LCD_PIO->txf[sm], NULL, 0, false);
+  dma_channel_set_irq1_enabled(chan, true);
+  return chan;
+}
+
+void lcd_dma_init() {
+  // Byte writes are replicated across the FIFO word, just as in lcd_pio_put()
+  lcd_dma_chan = lcd_dma_channel_init(LCD_PIO_SM, DMA_SIZE_8);
+#if LCD_USE_PIO_RGB
+  lcd_rgb_dma_chan = lcd_dma_channel_init(LCD_PIO_RGB_SM, DMA_SIZE_32);
+#endif
+
+  // Called from core1, so the IRQ is handled there too
+  irq_set_exclusive_handler(DMA_IRQ_1, lcd_dma_irq_handler);
+  irq_set_enabled(DMA_IRQ_1, true);
+}
+
+void lcd_dma_wait() {
+  while (dma_channel_is_busy(lcd_dma_chan)) __wfe();
+#if LCD_USE_PIO_RGB
+  while (dma_channel_is_busy(lcd_rgb_dma_chan)) __wfe();
+#endif
+}
+
+// Queue a buffer for sending, once any previous transfer has finished.
+// The buffer must not be touched until the following lcd_dma_put() or lcd_dma_wait() returns.
+void lcd_dma_put(const void *buf, uint count) {
+  lcd_dma_wait();
+#if LCD_USE_PIO_RGB
+  dma_channel_transfer_from_buffer_now(lcd_rgb_dma_chan, buf, count);
+#else
+  dma_channel_transfer_from_buffer_now(lcd_dma_chan, buf, count);
+#endif
+}
+#endif
+
+// Wait until a state machine stalls (meaning it has finished sending)
+static void lcd_pio_wait_idle(uint sm) {
+  uint32_t sm_stall_mask = 1u << (sm + PIO_FDEBUG_TXSTALL_LSB);
   LCD_PIO->fdebug = sm_stall_mask;
   while (!(LCD_PIO->fdebug & sm_stall_mask)) tight_loop_contents();
+}
+
+void lcd_pio_set_dc(bool dc) {
+#if LCD_USE_DMA
+  // Let any outstanding DMA transfer drain into the FIFO first
+  lcd_dma_wait();
+#endif
+  lcd_pio_wait_idle(LCD_PIO_SM);
   // Set the Data/Cmd pin (0 = Cmd, 1 = Data)
   gpio_put(LCD_PIN_DC, dc);
 }
 
+#if LCD_USE_PIO_RGB
+// Hand the pins over between the byte and packed-pixel state machines
+static void lcd_pio_select_rgb(bool rgb) {
+#if LCD_USE_DMA
+  lcd_dma_wait();
+#endif
+  lcd_pio_wait_idle(rgb ? LCD_PIO_SM : LCD_PIO_RGB_SM);
+  pio_sm_set_enabled(LCD_PIO, rgb ? LCD_PIO_SM : LCD_PIO_RGB_SM, false);
+  pio_sm_set_enabled(LCD_PIO, rgb ? LCD_PIO_RGB_SM : LCD_PIO_SM, true);
+}
+#endif
+
 void lcd_pio_put(uint8_t byte) {
   while (pio_sm_is_tx_fifo_full(LCD_PIO, LCD_PIO_SM)) tight_loop_contents();
   // Add 1 byte of data to the FIFO
@@ -71,9 +200,136 @@ void lcd_on() {
   pwm_set_gpio_level(LCD_PIN_LED, BRIGHTNESS_DEFAULT * BRIGHTNESS_DEFAULT);
 }
 
+// Send a start/end address pair for CASET or PASET
+static void lcd_set_address(uint8_t cmd, uint16_t start, uint16_t end) {
+  lcd_pio_set_dc(0);
+  lcd_pio_put(cmd);
+  lcd_pio_set_dc(1);
+  lcd_pio_put(start >> 8);
+  lcd_pio_put(start & 0xff);
+  lcd_pio_put(end >> 8);
+  lcd_pio_put(end & 0xff);
+}
+
+// Set the region the following Memory Write fills.
+// With MADCTL_MV set the column address is image x and the page address is image y.
+static void lcd_set_window(const rect_t *r) {
+  lcd_set_address(CMD_COLUMN_ADDRESS_SET, r->x, r->x + r->w - 1);
+  lcd_set_address(CMD_PAGE_ADDRESS_SET, r->y, r->y + r->h - 1);
+}
+
+// Copy screen rows y .. y_end-1 of the region into a snapshot buffer, returning the number of
+// FIFO writes (words or bytes) it holds.  src holds screen rows from src_y0 onwards.
+static uint lcd_snapshot_rows(const image_row_t *src, int src_y0, const rect_t *r, int y, int y_end, uint32_t *buf) {
+#if LCD_USE_PIO_RGB
+  // Regions are a whole number of words wide, so each row starts a fresh word
+  uint32_t *wp = buf;
+  for (int ly = y; ly < y_end; ly++) {
+    for (int x = r->x; x < r->x + r->w; x += PIO_RGB_PIXELS_PER_WORD) {
+      uint32_t word = 0;
+      for (int px = x; px < x + PIO_RGB_PIXELS_PER_WORD; px++) {
+        word = (word << 3) | palette_bits[image_get(src, px, ly - src_y0)];
+      }
+      // The state machine shifts out from the MSB
+      *wp++ = word << (32 - (PIO_RGB_PIXELS_PER_WORD * 3));
+    }
+  }
+  return wp - buf;
+#else
+  uint8_t *p = (uint8_t *)buf;
+  for (int ly = y; ly < y_end; ly++) {
+    for (int x = r->x; x < r->x + r->w; x++) {
+      const uint8_t *w = palette_wire[image_get(src, x, ly - src_y0)];
+      *p++ = w[0];
+      *p++ = w[1];
+      *p++ = w[2];
+    }
+  }
+  return p - (uint8_t *)buf;
+#endif
+}
+
+// Send just the given region of the image to the LCD
+static void lcd_push_rect(const rect_t *region) {
+#if LCD_USE_PIO_RGB
+  // Widen to whole FIFO words, otherwise the state machine would pad the last word with extra pixels
+  rect_t aligned = *region;
+  aligned.x -= aligned.x % PIO_RGB_PIXELS_PER_WORD;
+  aligned.w = region->x + region->w - aligned.x;
+  aligned.w += (PIO_RGB_PIXELS_PER_WORD - (aligned.w % PIO_RGB_PIXELS_PER_WORD)) % PIO_RGB_PIXELS_PER_WORD;
+  const rect_t *r = &aligned;
+#else
+  const rect_t *r = region;
+#endif
+  lcd_set_window(r);
+  lcd_pio_set_dc(0);
+  lcd_pio_put(CMD_MEMORY_WRITE); // Cmd: Memory Write
+  lcd_pio_set_dc(1);
+  stats.bytes_pushed += r->w * r->h * 3;
+#if LCD_USE_PIO_RGB
+  lcd_pio_select_rgb(true);
+  int rows_per_buf = LCD_SNAPSHOT_BYTES / (r->w / PIO_RGB_PIXELS_PER_WORD * 4);
+#else
+  int rows_per_buf = LCD_SNAPSHOT_BYTES / (r->w * 3);
+#endif
+#if USE_BAND_RENDER
+  if (rows_per_buf > BAND_LINES) rows_per_buf = BAND_LINES;
+#endif
+  // Copy the region into a snapshot one chunk at a time, holding the image lock only
+  // while copying, so drawing on core0 never waits for the SPI transfer itself.
+  // If the whole region fits in one snapshot it is sent exactly as it was at that moment.
+  int buf = 0;
+  for (int y = r->y; y < r->y + r->h; y += rows_per_buf) {
+    int y_end = y + rows_per_buf;
+    if (y_end > r->y + r->h) y_end = r->y + r->h;
+#if USE_BAND_RENDER
+    // No lock is needed - the band is built from core1's copy of the items, and band_render()
+    // draws with show_band_item(), which does not take the image mutex
+    uint count = lcd_snapshot_rows(band_render(y, y_end - y), y, r, y, y_end, snap_buf[buf]);
+#else
+    mutex_enter_blocking(img_mutex); // <<<<<<<<<<<<<  Lock image <<<<<<<<<<<<<<
+    uint count = lcd_snapshot_rows(disp_image, 0, r, y, y_end, snap_buf[buf]);
+    mutex_exit(img_mutex);    // <<<<<<<<<<< Unlock image <<<<<<<<<<<<<<<
+#endif
+#if LCD_USE_DMA
+    lcd_dma_put(snap_buf[buf], count);
+    buf ^= 1;
+#elif LCD_USE_PIO_RGB
+    for (uint i = 0; i < count; i++) pio_sm_put_blocking(LCD_PIO, LCD_PIO_RGB_SM, snap_buf[buf][i]);
+#else
+    for (uint i = 0; i < count; i++) lcd_pio_put(((uint8_t *)snap_buf[buf])[i]);
+#endif
+  }
+#if LCD_USE_PIO_RGB
+  lcd_pio_select_rgb(false);
+#elif LCD_USE_DMA
+  lcd_dma_wait();
+#endif
+}
+
+void lcd_build_palette_wire() {
+  for (int i = 0; i < PALETTE_SIZE; i++) {
+#if LCD_USE_PIO_RGB
+    // Only bit 0 of each channel survives the <<7 into a byte below
+    palette_bits[i] = ((palette[i].b & 1) << 2) | ((palette[i].g & 1) << 1) | (palette[i].r & 1);
+#else
+    palette_wire[i][0] = palette[i].b<<7;
+    palette_wire[i][1] = palette[i].g<<7;
+    palette_wire[i][2] = palette[i].r<<7;
+#endif
+  }
+}
+
 void core1_main() {
 
+  lcd_build_palette_wire();
   lcd_pio_init();
+#if LCD_USE_PIO_RGB
+  lcd_rgb_pio_init();
+#endif
+#if LCD_USE_DMA
+  lcd_dma_init();
+#endif
 
   // Hold the CS pin low
   gpio_init(LCD_PIN_CS);
@@ -98,7 +354,15 @@ void core1_main() {
   lcd_pio_put(CMD_SLEEP_OUT); 
   lcd_on(); 
 
+  // Address the panel in landscape so that memory writes run along image rows
+  lcd_pio_set_dc(0);
+  lcd_pio_put(CMD_MEMORY_ACCESS_CONTROL);
+  lcd_pio_set_dc(1);
+  lcd_pio_put(MADCTL_MV);
+
   // Clear the LCD
+  const rect_t whole_screen = {0, 0, LCD_WIDTH, LCD_HEIGHT};
+  lcd_set_window(&whole_screen);
   lcd_pio_set_dc(0);
   lcd_pio_put(CMD_MEMORY_WRITE); // Cmd: Memory Write
   lcd_pio_set_dc(1);
@@ -116,9 +380,12 @@ void core1_main() {
   pwm_set_gpio_level(LCD_PIN_LED, brightness * brightness);
   pwm_set_enabled(pwm_gpio_to_slice_num(LCD_PIN_LED), 1);
 
+  absolute_time_t next_frame = get_absolute_time();
   while (1) {
-    while (dirty == 0) busy_wait_ms(UPDATE_PERIOD_MS);
-    dirty--;
+    // Sleep until core0 publishes a new generation (lcd_invalidate() sends an event)
+    while (pushed_gen == frame_gen) __wfe();
+    sleep_until(next_frame);
+    next_frame = make_timeout_time_ms(LCD_MIN_FRAME_INTERVAL_MS);
 
     // if (rotate) {
     //   rotate = false;
@@ -127,37 +394,78 @@ void core1_main() {
     //   lcd_pio_put(CMD_MEMORY_ACCESS_CONTROL);
     //   lcd_pio_set_dc(1);
     //   if (rotated) {
-    //     lcd_pio_put(0x0);
+    //     lcd_pio_put(MADCTL_MV);
     //     rotated = 0;
     //   } else {
-    //     lcd_pio_put(0xc0);
+    //     lcd_pio_put(MADCTL_MY | MADCTL_MX | MADCTL_MV);
     //     rotated = 1;
     //   }
     // }
 
+    // Anything drawn after this point also bumps frame_gen, so will be picked up next time round
+    uint32_t gen = frame_gen;
+    uint32_t submit_us = oldest_submit_us;
+    taken_gen = gen;
+
+#if USE_DISPLAY_LIST
+    // Commands queued before the generation was published are rasterised now
+    dl_render(disp_image);
+#endif
+
     mutex_enter_blocking(img_mutex); // <<<<<<<<<<<<<  Lock image <<<<<<<<<<<<<<
-    lcd_pio_set_dc(0);
-    lcd_pio_put(CMD_MEMORY_WRITE); // Cmd: Memory Write
-    lcd_pio_set_dc(1);
-    for (int x = 0; x < LCD_WIDTH; x++) {
-      for (int y = 0; y < LCD_HEIGHT; y++) {
-          lcd_pio_put(disp_image[x][y].b<<7);
-          lcd_pio_put(disp_image[x][y].g<<7);
-          lcd_pio_put(disp_image[x][y].r<<7);
-      }
-    }
+    rect_t rects[MAX_DIRTY_RECTS];
+    int n_rects = take_dirty_rects(rects);
+#if USE_BAND_RENDER
+    band_take_items();
+#endif
     mutex_exit(img_mutex);    // <<<<<<<<<<< Unlock image <<<<<<<<<<<<<<<
+
+    for (int r = 0; r < n_rects; r++) {
+      lcd_push_rect(&rects[r]);
+    }
+    pushed_gen = gen;
+    stats.frames_pushed++;
+    stats.rects_pushed += n_rects;
+    if (n_rects > 0) {
+      uint32_t latency_us = time_us_32() - submit_us;
+      if ((stats.latency_samples == 0) || (latency_us < stats.latency_us_min)) stats.latency_us_min = latency_us;
+      if (latency_us > stats.latency_us_max) stats.latency_us_max = latency_us;
+      stats.latency_us_total += latency_us;
+      stats.latency_samples++;
+    }
   }
 }
 
 image_t * lcd_init(mutex_t *mtx) {
   img_mutex = mtx;
   multicore_launch_core1(core1_main);
+#if USE_BAND_RENDER
+  return NULL;
+#else
   return &disp_image;
+#endif
 }
 
+// Publish a new frame generation for core1 to send, and wake it.
+// May be called from both thread and lwIP callback context on core0, hence the IRQ guard.
 void lcd_invalidate() {
-  dirty = 2;
+  lcd_invalidate_since(time_us_32());
+}
+
+// As lcd_invalidate(), for changes made in response to something that happened at since_us
+// (e.g. a message held until the render tick), which is then when the latency clock starts.
+void lcd_invalidate_since(uint32_t since_us) {
+  uint32_t irq_status = save_and_disable_interrupts();
+  // The latency runs from the oldest update core1 has not yet looked at
+  if ((frame_gen == taken_gen) || ((int32_t)(since_us - oldest_submit_us) < 0)) oldest_submit_us = since_us;
+  frame_gen++;
+  restore_interrupts(irq_status);
+  __sev();
+}
+
+void lcd_get_stats(lcd_stats_t *s) {
+  *s = stats;
+  s->generations = frame_gen;
 }
 
 void lcd_brighten() {
@@ -172,5 +480,8 @@ void lcd_darken() {
 
 void lcd_rotate() {
   rotate = true;
+  mutex_enter_blocking(img_mutex);
+  mark_dirty(0, 0, LCD_WIDTH, LCD_HEIGHT);
+  mutex_exit(img_mutex);
   lcd_invalidate();
 }
@@ -13,7 +13,8 @@
 #include "graphics.h"
 #include "image.h"
 
-#define UPDATE_PERIOD_MS 100
+// Frame rate cap - minimum time from the start of one frame push to the start of the next
+#define LCD_MIN_FRAME_INTERVAL_MS 20
 
 // LCD is rotated 180 degrees
 #define LCD_ROTATE false
@@ -36,6 +37,9 @@
 #define LCD_PIO pio0
 #define LCD_PIO_SM 0
 
+// State machine for the lcd_rgb program, which shares the MOSI and CLK pins with LCD_PIO_SM
+#define LCD_PIO_RGB_SM 1
+
 // Clock divisor to use when sending commands (lower = faster)
 // 6.25 is within the datasheet spec
 #define LCD_PIO_CLKDIV_CMD 6.25f
@@ -44,23 +48,68 @@
 // 1.5 is outside spec but works
 #define LCD_PIO_CLKDIV_PIXELS 1.5f
 
+// The LCD_USE_ options and USE_BAND_RENDER may also be set by the build - the host tests are built each way
+
+// Feed pixel data to the PIO state machine via DMA rather than byte-by-byte from the CPU
+#ifndef LCD_USE_DMA
+#define LCD_USE_DMA true
+#endif
+
+// Send pixels as packed 3-bit words expanded by the lcd_rgb PIO program, rather than as
+// 3 bytes per pixel.  Dirty regions are widened to multiples of 8 pixels (one FIFO word).
+#ifndef LCD_USE_PIO_RGB
+#define LCD_USE_PIO_RGB true
+#endif
+
+// When true there is no framebuffer: the retained info items are re-rendered into a small
+// band buffer, BAND_LINES rows at a time, as each dirty region is sent (see bands.h)
+#ifndef USE_BAND_RENDER
+#define USE_BAND_RENDER false
+#endif
+
+// Size of each of the two region snapshot buffers that core1 sends from (RAM cost is double this).
+// Regions up to this size (at 3 bytes/pixel, or 3 bits/pixel with LCD_USE_PIO_RGB) are copied
+// in one go and so never tear; larger ones are copied and sent in chunks.
+// Must hold at least one row (LCD_WIDTH * 3).
+#define LCD_SNAPSHOT_BYTES (4 * LCD_HEIGHT * 3)
+
 // The small subset of ILI9488 commands we are currently using
 #define CMD_SLEEP_IN      0x10
 #define CMD_SLEEP_OUT     0x11
 #define CMD_DISPLAY_OFF   0x28
 #define CMD_DISPLAY_ON    0x29
+#define CMD_COLUMN_ADDRESS_SET 0x2A
+#define CMD_PAGE_ADDRESS_SET   0x2B
 #define CMD_MEMORY_WRITE  0x2C
 #define CMD_MEMORY_ACCESS_CONTROL 0X36
 #define CMD_PGAMCTRL      0xE0
 #define CMD_NGAMCTRL      0xE1
 
+// Memory Access Control (MADCTL) bits
+#define MADCTL_MY 0x80  // row address order
+#define MADCTL_MX 0x40  // column address order
+#define MADCTL_MV 0x20  // row/column exchange
+
+typedef struct {
+    uint32_t generations;   // frame generations published by core0
+    uint32_t frames_pushed; // frames actually sent by core1 (one may cover several generations)
+    uint32_t rects_pushed;  // dirty regions sent
+    uint32_t bytes_pushed;  // pixel bytes sent
+    uint32_t latency_samples;   // frames with a measured update-to-photon latency
+    uint32_t latency_us_min;    // time from an update (see lcd_invalidate_since) to the end of the push that sent it
+    uint32_t latency_us_max;
+    uint64_t latency_us_total;
+} lcd_stats_t;
+
 image_t * lcd_init(mutex_t *mtx);
 void lcd_off();
 void lcd_on();
 void lcd_invalidate();
+void lcd_invalidate_since(uint32_t since_us);
 void lcd_brighten();
 void lcd_darken();
 // void lcd_invert();
 void lcd_rotate();
+void lcd_get_stats(lcd_stats_t *s);
 
 #endif
\ No newline at end of file
@@ -5,77 +5,289 @@
 
 #include "mqtt.h"
 
-#include "math.h"
 #include "string.h"
 #include "pico/cyw43_arch.h"
+#include "pico/rand.h"
 #include "pico/time.h"
 
 #include "info_items.h"
+#include "sntp_clock.h"
 
-#define TIMEOUT_MS 10000
+// Size of the open-addressed topic hash table - a power of two, at least twice the topics routed
+#define TOPIC_ROUTES 32
+#if (URGENT_TEXT_SLOT + 2) * 2 > TOPIC_ROUTES  // the info items plus urgent and control
+#error "TOPIC_ROUTES is too small for MAX_TEXT_ITEMS"
+#endif
+
+typedef struct {
+    const char *topic;  // NULL for an empty entry
+    uint32_t hash;
+    uint16_t len;
+    int id;
+    u32_t limit;        // most of a payload kept, at most PAYLOAD_ARENA_SIZE
+} topic_route_t;
+
+static topic_route_t topic_routes[TOPIC_ROUTES];
+
+// For each topic length (63 for 63 or more): 0 if no routed topic is that long, LEN_SHARED if
+// several are, or else 1 + the topic_routes[] index of the one that is - checked before any hashing
+#define LEN_SHARED 0xff
+static uint8_t routes_by_len[64];
+
+#if SUBSCRIBE_PER_ITEM
+// lwIP sends one SUBSCRIBE per topic; keep one request slot free for publishing
+#define SUBSCRIBES_IN_FLIGHT (MQTT_REQ_MAX_IN_FLIGHT - 1)
+static int sub_next;        // topic_routes[] entry to subscribe to next
+static int subs_in_flight;
+#endif
 
 mqtt_client_t *client;
 ip_addr_t broker_addr;
 
+static char payload_arena[PAYLOAD_ARENA_SIZE];
+static u32_t inpub_len;     // total payload length of the publish being received
+static u32_t inpub_got;     // bytes of it received so far
+static u32_t inpub_limit;   // bytes of it kept, at most
+static mqtt_rx_stats_t rx_stats;
+
+// Connection state machine - only ever driven from the lwIP (async context) callbacks and workers
+typedef enum { LINK_DOWN, LINK_CONNECTING, LINK_UP, LINK_WAITING } link_state_t;
+
+static link_state_t link_state = LINK_DOWN;
+static int link_failures;               // consecutive failed attempts, for the backoff
+static absolute_time_t link_down_at;    // when the connection was lost (or first attempted)
+static mqtt_link_stats_t link_stats;
+
+static void reconnect_tick(async_context_t *context, async_at_time_worker_t *worker);
+static async_at_time_worker_t reconnect_worker = { .do_work = reconnect_tick };
+
+static void publish_pump();
+static void publish_requeue();
+
+/* topic_hash is 32-bit FNV-1a */
+static uint32_t topic_hash(const char *topic) {
+    uint32_t h = 2166136261u;
+    while (*topic) {
+        h ^= (uint8_t)*topic++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void add_route(const char *topic, int id, u32_t limit) {
+    if (limit > PAYLOAD_ARENA_SIZE) limit = PAYLOAD_ARENA_SIZE;
+    uint32_t h = topic_hash(topic);
+    for (uint32_t i = h & (TOPIC_ROUTES - 1); ; i = (i + 1) & (TOPIC_ROUTES - 1)) {
+        if (topic_routes[i].topic == NULL) {
+            topic_routes[i].topic = topic;
+            topic_routes[i].hash = h;
+            topic_routes[i].len = strlen(topic);
+            topic_routes[i].id = id;
+            topic_routes[i].limit = limit;
+            uint8_t *by_len = &routes_by_len[(topic_routes[i].len < 63) ? topic_routes[i].len : 63];
+            *by_len = (*by_len == 0) ? i + 1 : LEN_SHARED;
+            return;
+        }
+        if ((topic_routes[i].hash == h) && (strcmp(topic_routes[i].topic, topic) == 0)) {
+            // info items may share a topic (see info_setup), otherwise the first use wins
+            bool shared = (topic_routes[i].id >= 0) && (topic_routes[i].id < INFO_ITEM_COUNT) && (id < INFO_ITEM_COUNT);
+            if (!shared) printf("WARNING: Topic %s is used more than once - only the first use is shown\n", topic);
+            else if (limit > topic_routes[i].limit) topic_routes[i].limit = limit;
+            return;
+        }
+    }
+}
+
+static bool route_matches(const topic_route_t *route, const char *topic, size_t len) {
+    return (route->len == len) && (memcmp(route->topic, topic, len) == 0);
+}
+
+/* find_route returns the route for a topic, or NULL.  Topics we do not display are normally
+   rejected by their length alone.  A topic whose length only one route has is compared with it
+   directly; only lengths shared by several routes need hashing. */
+static const topic_route_t *find_route(const char *topic) {
+    size_t len = strlen(topic);
+    uint8_t by_len = routes_by_len[(len < 63) ? len : 63];
+    if (by_len == 0) return NULL;
+    if (by_len != LEN_SHARED) {
+        const topic_route_t *route = &topic_routes[by_len - 1];
+        return route_matches(route, topic, len) ? route : NULL;
+    }
+    uint32_t h = topic_hash(topic);
+    for (uint32_t i = h & (TOPIC_ROUTES - 1); topic_routes[i].topic != NULL; i = (i + 1) & (TOPIC_ROUTES - 1)) {
+        if ((topic_routes[i].hash == h) && route_matches(&topic_routes[i], topic, len)) return &topic_routes[i];
+    }
+    return NULL;
+}
+
+/* route_topic returns the ID for a topic, or ID_UNKNOWN */
+static int route_topic(const char *topic) {
+    const topic_route_t *route = find_route(topic);
+    return (route != NULL) ? route->id : ID_UNKNOWN;
+}
+
+/* item_payload_limit gives how much of a payload is kept for an info item - its value with some
+   slack, or the whole arena if the value is a field of a JSON payload */
+static u32_t item_payload_limit(const info_item_t *item) {
+    if (item->field_len > 0) return PAYLOAD_ARENA_SIZE;
+    return item->max_chars + PAYLOAD_SLACK;
+}
+
 void mqtt_setup_client() {
     client = mqtt_client_new();
     if (client == NULL) {
         printf("ERROR: Could not allocation new MQTT client\n");
     }
+    // same precedence as before: urgent, then the info items, then control
+    add_route(URGENT_TOPIC, ID_URGENT, MAX_URGENT_CHARS + PAYLOAD_SLACK);
+    for (int i = 0; i < INFO_ITEM_COUNT; ++i) {
+        if (is_clock_topic(info_items[i].topic)) continue;     // drawn locally
+        add_route(info_items[i].topic, i, item_payload_limit(&info_items[i]));
+    }
+    add_route(MQTT_CONTROL_TOPIC, ID_CONTROL, CONTROL_PAYLOAD_MAX);
 }
 
 int inpub_id;
 
 static void mqtt_incoming_publish_cb( __attribute__((unused)) void *arg, 
                                       const char *topic, 
-                                      __attribute__((unused)) u32_t tot_len) {
-    inpub_id = ID_UNKNOWN;
-    if(strcmp(topic, URGENT_TOPIC) == 0) {
-        inpub_id = ID_URGENT;
-        return;
-    } 
-    for (int i = 0; i < INFO_ITEM_COUNT; ++i) {
-        if (strcmp(topic, info_items[i].topic) == 0) {
-            inpub_id = i;
-            // printf("DEBUG: Matched topic >>>%s<<< ID: %d\n", info_items[i].topic, inpub_id);
-            return;
+                                      u32_t tot_len) {
+    const topic_route_t *route = find_route(topic);
+    inpub_id = (route != NULL) ? route->id : ID_UNKNOWN;
+    // if (inpub_id == ID_UNKNOWN) printf("DEBUG: Unmatched topic >>>%s<<< - ignoring\n", topic);
+    inpub_len = tot_len;
+    inpub_got = 0;
+    inpub_limit = (route != NULL) ? route->limit : 0;
+    if ((route != NULL) && (tot_len > route->limit)) {
+        if (inpub_id == ID_CONTROL) {
+            // a command cut short could be a different command
+            ++rx_stats.overflows;
+            printf("WARNING: %lu byte payload on %s is too long - ignoring it\n", (unsigned long)tot_len, topic);
+            inpub_id = ID_UNKNOWN;
+        } else {
+            // text is shown as far as there is room for it
+            ++rx_stats.truncated;
         }
     }
-    if(strcmp(topic, MQTT_CONTROL_TOPIC) == 0) {
-        inpub_id = ID_CONTROL;
-        return;
-    } 
-    // printf("DEBUG: Unmatched topic >>>%s<<< - ignoring\n", topic);
 }
 
 static void mqtt_incoming_data_cb(__attribute__((unused)) void *arg, const u8_t *data, u16_t len, u8_t flags) {
-    char payload[MQTT_VAR_HEADER_BUFFER_LEN];
     // printf("DEBUG: Incoming data payload with length %d, flags %u\n", len, (unsigned int)flags);
-    if (inpub_id != ID_UNKNOWN) {
-        if(flags & MQTT_DATA_FLAG_LAST) {
-            /* Last fragment of payload received (or whole part if payload fits receive buffer
-               See MQTT_VAR_HEADER_BUFFER_LEN)  */
-            strncpy((char *)&payload, (const char *)data, (size_t) len);
-            payload[len] = '\0';
-            show_data(inpub_id, payload, len);
-            // printf("DEBUG: Payload: %s\n", payload); 
-        } else {
-            printf("WARNING: Received fragmented MQTT payload - ignoring it\n");
+    if (inpub_id == ID_UNKNOWN) return;
+    if ((flags & MQTT_DATA_FLAG_LAST) && (inpub_got == 0)) {
+        /* The whole payload is in this fragment (see MQTT_VAR_HEADER_BUFFER_LEN) - use it in place */
+        ++rx_stats.payloads;
+        show_data(inpub_id, (const char *)data, (len < inpub_limit) ? len : inpub_limit);
+        return;
+    }
+    if (inpub_got + len > inpub_len) {
+        ++rx_stats.overflows;
+        printf("WARNING: MQTT payload longer than announced - ignoring it\n");
+        inpub_id = ID_UNKNOWN;
+        return;
+    }
+    // only the first inpub_limit bytes go into the arena
+    if (inpub_got < inpub_limit) {
+        u32_t n = (inpub_got + len > inpub_limit) ? inpub_limit - inpub_got : len;
+        memcpy(&payload_arena[inpub_got], data, n);
+    }
+    inpub_got += len;
+    if (flags & MQTT_DATA_FLAG_LAST) {
+        ++rx_stats.payloads;
+        ++rx_stats.reassembled;
+        show_data(inpub_id, payload_arena, (inpub_got < inpub_limit) ? inpub_got : inpub_limit);
+    }
+}
+
+static void mqtt_sub_request_cb(void *arg, err_t result);
+
+#if SUBSCRIBE_PER_ITEM
+/* subscribe_next queues subscriptions to the routed topics, as many at a time as lwIP has
+   request slots for; each completion queues the next */
+static void subscribe_next(void *arg) {
+    cyw43_arch_lwip_begin();
+    while ((subs_in_flight < SUBSCRIBES_IN_FLIGHT) && (sub_next < TOPIC_ROUTES)) {
+        const char *topic = topic_routes[sub_next++].topic;
+        if (topic == NULL) continue;
+        err_t err = mqtt_subscribe(client, topic, 0, mqtt_sub_request_cb, arg);
+        if ((err == ERR_MEM) && (subs_in_flight > 0)) {
+            --sub_next;     // request queue full - retry when the next subscription completes
+            break;
+        }
+        if (err != ERR_OK) {
+            printf("ERROR: mqtt_subscribe to %s return: %d\n", topic, err);
+            continue;
         }
-    } 
+        ++subs_in_flight;
+    }
+    cyw43_arch_lwip_end();
 }
+#endif
 
 static void mqtt_sub_request_cb(__attribute__((unused)) void *arg, err_t result) {
-    printf("DEBUG: Subscribe result: %d\n", result);
+    if (result != ERR_OK) printf("DEBUG: Subscribe result: %d\n", result);
+#if SUBSCRIBE_PER_ITEM
+    if (subs_in_flight > 0) --subs_in_flight;
+    subscribe_next(arg);
+#endif
+}
+
+/* schedule_reconnect waits an exponentially growing, jittered time before the next attempt.
+   The jitter stops a group of panels that lost the broker together all retrying in step. */
+static void schedule_reconnect() {
+    uint32_t delay_ms = RECONNECT_MAX_MS;
+    if ((link_failures < 16) && ((RECONNECT_MIN_MS << link_failures) < RECONNECT_MAX_MS)) {
+        delay_ms = RECONNECT_MIN_MS << link_failures;
+    }
+    delay_ms = delay_ms / 2 + get_rand_32() % (delay_ms / 2 + 1);
+    ++link_failures;
+    link_state = LINK_WAITING;
+    printf("INFO: MQTT reconnect in %lu ms\n", (unsigned long)delay_ms);
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &reconnect_worker, delay_ms);
+}
+
+/* link_lost is called whenever an attempt fails or an established connection drops */
+static void link_lost() {
+    if (link_state == LINK_WAITING) return;     // already backing off
+    if (link_state == LINK_UP) {
+        ++link_stats.disconnects;
+        link_down_at = get_absolute_time();
+        link_failures = 0;
+    } else {
+        ++link_stats.failures;
+    }
+    schedule_reconnect();
+}
+
+static void reconnect_tick(__attribute__((unused)) async_context_t *context, 
+                           __attribute__((unused)) async_at_time_worker_t *worker) {
+    mqtt_connect();
 }
 
 static void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status_t status) {
-    err_t err;
     if(status == MQTT_CONNECT_ACCEPTED) {
         printf("DEBUG: mqtt_connection_cb: Successfully connected\n");
+        uint32_t latency_ms = absolute_time_diff_us(link_down_at, get_absolute_time()) / 1000;
+        link_state = LINK_UP;
+        link_failures = 0;
+        ++link_stats.connects;
+        link_stats.latency_ms_last = latency_ms;
+        if (latency_ms > link_stats.latency_ms_max) link_stats.latency_ms_max = latency_ms;
+        link_stats.latency_ms_total += latency_ms;
         /* Setup callback for incoming publish requests */
         mqtt_set_inpub_callback(client, mqtt_incoming_publish_cb, mqtt_incoming_data_cb, arg);
 
+        /* resend whatever was queued or in flight while the link was down, in either subscription mode */
+        publish_requeue();
+        publish_pump();
+
+#if SUBSCRIBE_PER_ITEM
+        /* (re)subscribe from the start - lwIP drops any requests outstanding when a connection closes */
+        sub_next = 0;
+        subs_in_flight = 0;
+        subscribe_next(arg);
+#else
+        err_t err;
         cyw43_arch_lwip_begin(); /* start section for to lwIP access */
         err = mqtt_subscribe(client, TOPIC, 0, mqtt_sub_request_cb, arg);
         cyw43_arch_lwip_end(); /* end section accessing lwIP */
@@ -83,16 +295,22 @@ static void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection
         if(err != ERR_OK) {
             printf("ERROR: mqtt_subscribe return: %d\n", err);
         }
+#endif
     } else {
-        printf("ERROR: MQTT connection CB got code %d - will retry in 10s\n", status);
-        busy_wait_ms(TIMEOUT_MS);    // wait 10s and retry
-        mqtt_connect();
+        printf("ERROR: MQTT connection CB got code %d\n", status);
+        link_lost();
     }
 }
 
+/* mqtt_connect starts a connection attempt and returns at once; failures are retried with backoff */
 void mqtt_connect() {
     struct mqtt_connect_client_info_t ci;
     err_t err;
+
+    if (link_state == LINK_DOWN) link_down_at = get_absolute_time();
+    if ((link_state == LINK_UP) || (link_state == LINK_CONNECTING)) return;
+    link_state = LINK_CONNECTING;
+    ++link_stats.attempts;
   
     /* Setup an empty client info structure */
     memset(&ci, 0, sizeof(ci));
@@ -102,6 +320,7 @@ void mqtt_connect() {
 
     if (!ip4addr_aton(BROKER_HOST, &broker_addr)) {
         printf("ERROR: Could not resolve MQTT Broker address\n");
+        link_lost();
         return;
     }
     cyw43_arch_lwip_begin(); /* start section for to lwIP access */
@@ -112,8 +331,7 @@ void mqtt_connect() {
         printf("DEBUG: mqtt_connect OK\n");
     } else {
         printf("ERROR: mqtt_connect return %d\n", err);
-        sleep_ms(TIMEOUT_MS);    // wait 10s and retry
-        mqtt_connect();
+        link_lost();
     }
 }
 
@@ -124,19 +342,150 @@ bool mqtt_connected() {
         return false;
 }
 
-void mqtt_pub_request_cb(__attribute__((unused)) void *arg, err_t err) {
-    // MQTT_CLIENT_T *state = (MQTT_CLIENT_T *)arg;
-    if (err != 0) printf("DEBUG: mqtt_pub_request_cb: err %d\n", err);
-    // state->received++;
+/* mqtt_reconnecting is true while a lost connection is still being retried within RECONNECT_GIVE_UP_MS */
+bool mqtt_reconnecting() {
+    if ((link_state != LINK_CONNECTING) && (link_state != LINK_WAITING)) return false;
+    return absolute_time_diff_us(link_down_at, get_absolute_time()) < (int64_t)RECONNECT_GIVE_UP_MS * 1000;
+}
+
+/* Outgoing publishes wait in a bounded queue and are handed to lwIP a few at a time, each entry
+   staying queued until lwIP reports it sent (QoS 0) or acknowledged (QoS 1), so that it can be
+   retried.  The queue is only touched with the lwIP lock held. */
+
+typedef enum { PUB_FREE, PUB_QUEUED, PUB_IN_FLIGHT } pub_state_t;
+
+typedef struct {
+    pub_state_t state;
+    const char *topic;
+    char payload[PUBLISH_PAYLOAD_MAX];
+    uint8_t len;
+    uint8_t retries;
+} pub_entry_t;
+
+static pub_entry_t pub_queue[PUBLISH_QUEUE_LEN];
+static int pubs_in_flight;
+static mqtt_pub_stats_t pub_stats;
+
+static void mqtt_pub_request_cb(void *arg, err_t err) {
+    pub_entry_t *entry = (pub_entry_t *)arg;
+    if (entry->state != PUB_IN_FLIGHT) return;     // requeued by a reconnect meanwhile
+    --pubs_in_flight;
+    if (err == ERR_OK) {
+        entry->state = PUB_FREE;
+        ++pub_stats.sent;
+    } else if (entry->retries < PUBLISH_RETRIES) {
+        printf("DEBUG: mqtt_pub_request_cb: err %d - retrying\n", err);
+        entry->state = PUB_QUEUED;
+        ++entry->retries;
+        ++pub_stats.retried;
+    } else {
+        printf("WARNING: Publish to %s failed - dropping it\n", entry->topic);
+        entry->state = PUB_FREE;
+        ++pub_stats.dropped;
+    }
+    publish_pump();
+}
+
+/* publish_pump hands queued entries to lwIP, oldest first, while there are request slots for them */
+static void publish_pump() {
+    if (!mqtt_connected()) return;
+    for (int i = 0; (i < PUBLISH_QUEUE_LEN) && (pubs_in_flight < PUBLISHES_IN_FLIGHT); ++i) {
+        pub_entry_t *entry = &pub_queue[i];
+        if (entry->state != PUB_QUEUED) continue;
+        err_t err = mqtt_publish(client, entry->topic, entry->payload, entry->len, PUBLISH_QOS, 0, 
+                                 mqtt_pub_request_cb, entry);
+        if (err != ERR_OK) break;   // no room in lwIP now - try again as requests complete
+        entry->state = PUB_IN_FLIGHT;
+        ++pubs_in_flight;
+    }
+}
+
+/* publish_requeue puts back everything in flight, since lwIP drops its requests when a connection closes */
+static void publish_requeue() {
+    for (int i = 0; i < PUBLISH_QUEUE_LEN; ++i) {
+        if (pub_queue[i].state == PUB_IN_FLIGHT) {
+            pub_queue[i].state = PUB_QUEUED;
+            ++pub_stats.retried;
+        }
+    }
+    pubs_in_flight = 0;
+}
+
+/* mqtt_queue_publish queues a payload for a topic, replacing any older one for the same topic
+   not yet sent.  The topic must remain valid; returns false (and counts a drop) if the queue is full. */
+bool mqtt_queue_publish(const char *topic, const char *payload, int len) {
+    if (len > PUBLISH_PAYLOAD_MAX) len = PUBLISH_PAYLOAD_MAX;
+    cyw43_arch_lwip_begin();
+    pub_entry_t *entry = NULL;
+    for (int i = 0; i < PUBLISH_QUEUE_LEN; ++i) {
+        if ((pub_queue[i].state == PUB_QUEUED) && (pub_queue[i].topic == topic)) {
+            entry = &pub_queue[i];
+            ++pub_stats.coalesced;
+            break;
+        }
+        if ((entry == NULL) && (pub_queue[i].state == PUB_FREE)) entry = &pub_queue[i];
+    }
+    if (entry == NULL) {
+        ++pub_stats.dropped;
+        cyw43_arch_lwip_end();
+        return false;
+    }
+    entry->state = PUB_QUEUED;
+    entry->topic = topic;
+    memcpy(entry->payload, payload, len);
+    entry->len = len;
+    entry->retries = 0;
+    ++pub_stats.queued;
+    publish_pump();
+    cyw43_arch_lwip_end();
+    return true;
+}
+
+/* format_fixed writes value / 10^decimals, e.g. 213 with 1 decimal as "21.3", returning its length */
+static int format_fixed(char *buf, int32_t value, int decimals) {
+    char digits[12];
+    int n = 0;
+    int len = 0;
+    int min_chars = (decimals > 0) ? decimals + 2 : 1;    // always a digit before any point
+    uint32_t v = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+    if (value < 0) buf[len++] = '-';
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+        if (n == decimals) digits[n++] = '.';
+    } while ((v > 0) || (n < min_chars));
+    while (n > 0) buf[len++] = digits[--n];
+    return len;
+}
+
+/* round_to_int rounds half away from zero, without pulling in the maths library */
+static int32_t round_to_int(float f) {
+    return (int32_t)((f < 0.0f) ? f - 0.5f : f + 0.5f);
 }
 
 void publish_sensors(float temp, float hum) {
-    char temp_s[10];
-    char hum_s[10];
-    sprintf(temp_s, "%.1f", temp);
-    sprintf(hum_s, "%d", (int) round(hum));
+    uint64_t start = time_us_64();
+    char temp_s[PUBLISH_PAYLOAD_MAX];
+    char hum_s[PUBLISH_PAYLOAD_MAX];
+    int temp_len = format_fixed(temp_s, round_to_int(temp * 10.0f), 1);
+    int hum_len = format_fixed(hum_s, round_to_int(hum), 0);
+    mqtt_queue_publish(TEMP_TOPIC, temp_s, temp_len);
+    mqtt_queue_publish(HUMIDITY_TOPIC, hum_s, hum_len);
+    uint32_t us = time_us_64() - start;
+    if (us > pub_stats.cycle_us_max) pub_stats.cycle_us_max = us;
+}
+
+void mqtt_get_pub_stats(mqtt_pub_stats_t *stats) {
     cyw43_arch_lwip_begin();
-    mqtt_publish(client, TEMP_TOPIC, temp_s, strlen(temp_s), 0, 0, mqtt_pub_request_cb, 0);
-    mqtt_publish(client, HUMIDITY_TOPIC, hum_s, strlen(hum_s), 0, 0, mqtt_pub_request_cb, 0);
+    *stats = pub_stats;
+    stats->in_flight = pubs_in_flight;
     cyw43_arch_lwip_end();
+}
+
+void mqtt_get_rx_stats(mqtt_rx_stats_t *stats) {
+    *stats = rx_stats;
+}
+
+void mqtt_get_link_stats(mqtt_link_stats_t *stats) {
+    *stats = link_stats;
 }
\ No newline at end of file
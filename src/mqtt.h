@@ -8,10 +8,7 @@
 
 #include "lwip/apps/mqtt.h"
 
-// Define ONE of the following (see also info_items.c)
-// #define CLOCK1
-#define CLOCK2
-// #define INFOPANEL1
+#include "layout.h"     // selects CLOCK1, CLOCK2 or INFOPANEL1
 
 #ifdef CLOCK1
     #define MQTT_CLIENT_ID "PicowClock1"
@@ -29,11 +26,58 @@
 #define BROKER_HOST "192.168.1.10"
 #define BROKER_PORT 1883
 #define BROKER_KEEPALIVE 60
-#define TOPIC          "rgbmatrix/#"         // <== This is what we subscribe to
+#define TOPIC          "rgbmatrix/#"         // <== This is what we subscribe to, unless...
+#ifndef SUBSCRIBE_PER_ITEM                   // (may also be set by the build)
+#define SUBSCRIBE_PER_ITEM true              // subscribe to only the displayed, urgent and control topics
+#endif
 #define URGENT_TOPIC   "rgbmatrix/urgent"
 #define TEMP_TOPIC     "rgbmatrix/Pauls_Studio/temperature"
 #define HUMIDITY_TOPIC "rgbmatrix/Pauls_Studio/humidity"
 
+// Reconnection backoff: doubling from MIN to MAX, with jitter, after each failed attempt
+#define RECONNECT_MIN_MS 1000
+#define RECONNECT_MAX_MS 60000
+#define RECONNECT_GIVE_UP_MS (10 * 60 * 1000)   // then stop feeding the watchdog and reboot
+
+typedef struct {
+    uint32_t attempts;          // connection attempts started
+    uint32_t connects;          // ... accepted by the broker
+    uint32_t failures;          // ... failed or refused
+    uint32_t disconnects;       // established connections lost
+    uint32_t latency_ms_last;   // time from losing (or first attempting) the connection until accepted
+    uint32_t latency_ms_max;
+    uint64_t latency_ms_total;  // over 'connects'
+} mqtt_link_stats_t;
+
+// Outgoing publishes - queued, then handed to lwIP PUBLISHES_IN_FLIGHT at a time
+#define PUBLISH_QOS 0                   // 1 to have the broker acknowledge each publish
+#define PUBLISH_QUEUE_LEN 8
+#define PUBLISH_PAYLOAD_MAX 12
+#define PUBLISHES_IN_FLIGHT 1           // see SUBSCRIBES_IN_FLIGHT in mqtt.c
+#define PUBLISH_RETRIES 3
+
+typedef struct {
+    uint32_t queued;            // payloads queued for publishing
+    uint32_t coalesced;         // ... which replaced an older unsent payload for the same topic
+    uint32_t sent;              // sent (QoS 0) or acknowledged (QoS 1)
+    uint32_t retried;           // attempts repeated after an error or reconnect
+    uint32_t dropped;           // payloads lost to a full queue or repeated errors
+    uint32_t in_flight;
+    uint32_t cycle_us_max;      // longest publish_sensors() call
+} mqtt_pub_stats_t;
+
+// Payloads are reassembled in a fixed arena, up to their topic's limit; text beyond it is cut off
+#define PAYLOAD_ARENA_SIZE 1024
+#define CONTROL_PAYLOAD_MAX 16
+#define PAYLOAD_SLACK 8                 // accepted beyond an item's max_chars, e.g. for extra decimals
+
+typedef struct {
+    uint32_t payloads;      // payloads passed on for display or control
+    uint32_t reassembled;   // ... of which arrived in more than one fragment
+    uint32_t truncated;     // ... cut short at their topic's limit
+    uint32_t overflows;     // payloads dropped: control commands over their limit, or longer than announced
+} mqtt_rx_stats_t;
+
 // User topics are matched to IDs 0 .. n
 #define ID_UNKNOWN -1
 #define ID_CONTROL 998
@@ -42,6 +86,11 @@
 void mqtt_setup_client();
 void mqtt_connect();
 bool mqtt_connected();
+bool mqtt_reconnecting();
 void publish_sensors(float temp, float hum);
+bool mqtt_queue_publish(const char *topic, const char *payload, int len);
+void mqtt_get_pub_stats(mqtt_pub_stats_t *stats);
+void mqtt_get_rx_stats(mqtt_rx_stats_t *stats);
+void mqtt_get_link_stats(mqtt_link_stats_t *stats);
 
 #endif
\ No newline at end of file
@@ -17,20 +17,28 @@
 #include "info_items.h"
 #include "lcd.h"
 #include "mqtt.h"
-#include "pico_dht/dht/include/dht.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "sntp_clock.h"
 #include "wifi_config.h"
 
 #define RETRY_MS 5000
 #define BLINK_PERIOD_MS 1000
 #define WATCHDOG_TIMEOUT_MS  3000 // max is ~4700
-#define DHT_SAMPLE_PERIOD 120 // multiply by BLINK_PERIOD_MS to get real period
-#define DHT_TEMP_OFFSET -1.0  // Some units need calibration and an offset applied
-#define DHT_HUM_OFFSET -5
+#define WATCHDOG_FEED_MS 1000
 
 static image_t * image_ptr;
 static mutex_t image_mutex;
-static const dht_model_t DHT_MODEL = DHT22;
-static const uint DATA_PIN = 7; // GPIO7 - physical pin 10
+static bool flash_toggle = false;
+
+static void blink_job() {
+    flash_toggle = !flash_toggle;
+    if (flash_toggle) show_urgent(); else hide_urgent();
+}
+
+static void watchdog_job() {
+    if (mqtt_connected() || mqtt_reconnecting()) watchdog_update();    // feed the watchdog
+}
 
 int main() {
     stdio_init_all();
@@ -38,9 +46,7 @@ int main() {
 
     if (watchdog_caused_reboot()) printf("INFO: Rebooted due to Watchdog timeout\n");
 
-    // set up the AM2302/DHT22 Temp & Hum sensor
-    dht_t dht;
-    dht_init(&dht, DHT_MODEL, pio1, DATA_PIN, true);
+    sensors_setup();
 
     mutex_init(&image_mutex);
 
@@ -67,36 +73,14 @@ int main() {
     cyw43_wifi_pm(&cyw43_state, cyw43_pm_value(CYW43_NO_POWERSAVE_MODE, 20, 1, 1, 1));
         
     info_setup(image_ptr);
+    clock_setup();
 
     mqtt_setup_client();
-    mqtt_connect();     // does not return until connection is established
-    printf("DEBUG: Connected to MQTT broker\n");
+    mqtt_connect();     // returns at once, retrying in the background until connected
 
     watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
 
-    bool flash_toggle = false;
-    int dht_counter = DHT_SAMPLE_PERIOD - 1; // we try to get an inital reading quite quickly
-    float humidity = 0.0f;
-    float temperature = 0.0f;
-    while (true) {
-        busy_wait_ms(BLINK_PERIOD_MS);
-        flash_toggle = !flash_toggle;
-        if (flash_toggle) show_urgent(); else hide_urgent();
-
-        if (mqtt_connected()) watchdog_update();    // feed the watchdog
-
-        ++dht_counter;
-        if (dht_counter == DHT_SAMPLE_PERIOD) {
-            dht_counter = 0;
-            dht_start_measurement(&dht);
-            dht_result_t result = dht_finish_measurement_blocking(&dht, &humidity, &temperature);
-            if (result == DHT_RESULT_OK) {
-                if (mqtt_connected()) {
-                    publish_sensors(temperature + DHT_TEMP_OFFSET, humidity + DHT_HUM_OFFSET);
-                }
-            } else {
-                printf("WARNING: DHT Sensor read failure\n");
-            }
-        }
-    }
+    sched_add("blink", BLINK_PERIOD_MS, BLINK_PERIOD_MS, blink_job);
+    sched_add("watchdog", WATCHDOG_FEED_MS, 0, watchdog_job);
+    sched_run();    // does not return
 }
\ No newline at end of file
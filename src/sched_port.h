@@ -0,0 +1,17 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SCHED_PORT_H
+#define SCHED_PORT_H
+
+#include <stdint.h>
+
+/* The time and alarm calls the scheduler needs from the platform - sched_port_pico.c on the Pico W,
+   and a simulated clock in the host tests */
+
+uint64_t sched_port_now_us();                   // microseconds since boot
+void sched_port_sleep_until(uint64_t at_us);    // returns at once if at_us has passed
+
+#endif
@@ -0,0 +1,18 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "sched_port.h"
+
+#include "pico/time.h"
+
+uint64_t sched_port_now_us() {
+    return time_us_64();
+}
+
+/* sched_port_sleep_until sleeps in __wfe() on a one-shot alarm from the default alarm pool;
+   interrupts (USB, the CYW43 background work, DMA) are still serviced meanwhile */
+void sched_port_sleep_until(uint64_t at_us) {
+    sleep_until(from_us_since_boot(at_us));
+}
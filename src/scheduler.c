@@ -0,0 +1,118 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "scheduler.h"
+
+#include <stdio.h>
+
+#include "sched_port.h"
+
+/* A cooperative scheduler for core0.  Each job keeps its own deadlines: a fixed-rate one for
+   periodic jobs, and a one-shot one set by sched_wake().  sched_step() marks the jobs whose
+   deadlines have passed as due (an overrun if one already was), runs them in order, and gives the
+   next deadline; sched_run() sleeps until then via the port (sched_port.h). */
+
+#define NO_DEADLINE UINT64_MAX
+
+typedef struct {
+    sched_fn_t fn;
+    uint32_t first_ms;
+    bool due;
+    uint64_t next_us;       // next fixed-rate deadline
+    uint64_t wake_us;       // pending sched_wake() deadline
+    sched_job_stats_t stats;
+} job_t;
+
+static job_t jobs[SCHED_MAX_JOBS];
+static int job_count;
+
+int sched_add(const char *name, uint32_t period_ms, uint32_t first_ms, sched_fn_t fn) {
+    if (job_count == SCHED_MAX_JOBS) {
+        printf("ERROR: Too many scheduled jobs for SCHED_MAX_JOBS\n");
+        return -1;
+    }
+    job_t *job = &jobs[job_count];
+    job->fn = fn;
+    job->first_ms = first_ms;
+    job->next_us = NO_DEADLINE;
+    job->wake_us = NO_DEADLINE;
+    job->stats.name = name;
+    job->stats.period_ms = period_ms;
+    return job_count++;
+}
+
+/* sched_wake runs a job once, delay_ms from now - typically to finish something it started.  Only
+   the earliest pending wake is kept.  Call it from a job, not an interrupt handler. */
+void sched_wake(int job, uint32_t delay_ms) {
+    uint64_t at = sched_port_now_us() + (uint64_t)delay_ms * 1000;
+    if (at < jobs[job].wake_us) jobs[job].wake_us = at;
+}
+
+static void mark_due(job_t *job) {
+    if (job->due) ++job->stats.overruns;
+    job->due = true;
+}
+
+/* mark_deadlines marks each job due whose deadlines have passed; a fixed-rate job that has missed
+   several periods is counted an overrun for each */
+static void mark_deadlines(uint64_t now) {
+    for (int i = 0; i < job_count; ++i) {
+        job_t *job = &jobs[i];
+        while (job->next_us <= now) {
+            mark_due(job);
+            // the next deadline is a fixed period after the last, however long each run takes
+            job->next_us += (uint64_t)job->stats.period_ms * 1000;
+        }
+        if (job->wake_us <= now) {
+            mark_due(job);
+            job->wake_us = NO_DEADLINE;
+        }
+    }
+}
+
+static void sched_start() {
+    uint64_t now = sched_port_now_us();
+    for (int i = 0; i < job_count; ++i) {
+        if (jobs[i].stats.period_ms > 0) jobs[i].next_us = now + (uint64_t)jobs[i].first_ms * 1000;
+    }
+}
+
+/* sched_step runs the jobs now due and returns when the next one will be */
+static uint64_t sched_step() {
+    mark_deadlines(sched_port_now_us());
+    for (int i = 0; i < job_count; ++i) {
+        job_t *job = &jobs[i];
+        if (!job->due) continue;
+        job->due = false;
+        uint64_t start = sched_port_now_us();
+        job->fn();
+        uint64_t end = sched_port_now_us();
+        uint32_t run_us = end - start;
+        if (run_us > job->stats.max_run_us) job->stats.max_run_us = run_us;
+        ++job->stats.runs;
+        // deadlines passed during the run count against jobs still waiting
+        mark_deadlines(end);
+    }
+    uint64_t next = NO_DEADLINE;
+    for (int i = 0; i < job_count; ++i) {
+        if (jobs[i].due) return sched_port_now_us();
+        if (jobs[i].next_us < next) next = jobs[i].next_us;
+        if (jobs[i].wake_us < next) next = jobs[i].wake_us;
+    }
+    return next;
+}
+
+void sched_run() {
+    sched_start();
+    while (true) sched_port_sleep_until(sched_step());
+}
+
+int sched_job_count() {
+    return job_count;
+}
+
+void sched_get_job_stats(int job, sched_job_stats_t *stats) {
+    *stats = jobs[job].stats;
+}
@@ -0,0 +1,32 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHED_MAX_JOBS 8
+
+typedef void (*sched_fn_t)(void);
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    uint32_t runs;
+    uint32_t overruns;      // deadlines reached while the job was still waiting to run
+    uint32_t max_run_us;    // longest time the job took
+} sched_job_stats_t;
+
+// Jobs run on core0, one at a time, at fixed rates; the first run is first_ms after sched_run() starts.
+// A job with a period of 0 only runs when woken by sched_wake().
+int sched_add(const char *name, uint32_t period_ms, uint32_t first_ms, sched_fn_t fn);
+void sched_wake(int job, uint32_t delay_ms);
+void sched_run();
+int sched_job_count();
+void sched_get_job_stats(int job, sched_job_stats_t *stats);
+
+#endif
@@ -0,0 +1,140 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "sensors.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "pico/time.h"
+
+#include "mqtt.h"
+#include "pico_dht/dht/include/dht.h"
+#include "scheduler.h"
+
+/* The AM2302/DHT22 is read without blocking: one job starts a measurement, which the PIO and DMA
+   complete in the background, and a second job, woken shortly afterwards, collects the result. */
+
+static const dht_model_t DHT_MODEL = DHT22;
+static dht_t dht;
+static int collect_job;
+static uint64_t started_us;
+static sensor_stats_t stats;
+
+// Recent raw readings, with the offsets applied
+static float temp_ring[SAMPLE_RING_LEN];
+static float hum_ring[SAMPLE_RING_LEN];
+static int ring_next;
+static int ring_count;
+
+static float temp_ema;
+static float hum_ema;
+static bool published_once;
+static float temp_published;
+static float hum_published;
+static uint64_t published_us;
+
+/* median returns the middle (or lower middle) of the first n values of ring, n at most SAMPLE_RING_LEN */
+static float median(const float ring[], int n) {
+    float sorted[SAMPLE_RING_LEN];
+    memcpy(sorted, ring, n * sizeof(float));
+    for (int i = 1; i < n; ++i) {
+        float v = sorted[i];
+        int j = i;
+        for (; (j > 0) && (sorted[j - 1] > v); --j) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    return sorted[(n - 1) / 2];
+}
+
+static float absf(float f) {
+    return (f < 0.0f) ? -f : f;
+}
+
+/* add_sample filters a new reading and publishes the result if it has moved, or is due anyway */
+static void add_sample(float temperature, float humidity) {
+    temp_ring[ring_next] = temperature;
+    hum_ring[ring_next] = humidity;
+    ring_next = (ring_next + 1) % SAMPLE_RING_LEN;
+    if (ring_count < SAMPLE_RING_LEN) ++ring_count;
+
+    float temp_median = median(temp_ring, ring_count);
+    float hum_median = median(hum_ring, ring_count);
+    if (ring_count == 1) {
+        temp_ema = temp_median;
+        hum_ema = hum_median;
+    } else {
+        temp_ema += SAMPLE_EMA_ALPHA * (temp_median - temp_ema);
+        hum_ema += SAMPLE_EMA_ALPHA * (hum_median - hum_ema);
+    }
+
+    // queued while the link is down too: the queue keeps only the latest for each topic, and sends
+    // it on reconnecting
+    uint64_t now = time_us_64();
+    bool due = !published_once || 
+               (absf(temp_ema - temp_published) >= TEMP_DEADBAND) ||
+               (absf(hum_ema - hum_published) >= HUM_DEADBAND) ||
+               (now - published_us >= (uint64_t)PUBLISH_HEARTBEAT_MS * 1000);
+    if (!due) {
+        ++stats.suppressed;
+        return;
+    }
+    publish_sensors(temp_ema, hum_ema);
+    published_once = true;
+    temp_published = temp_ema;
+    hum_published = hum_ema;
+    published_us = now;
+    ++stats.published;
+}
+
+static void dht_start_job() {
+    started_us = time_us_64();
+    ++stats.reads;
+    dht_start_measurement(&dht);
+    sched_wake(collect_job, DHT_READ_MS);
+}
+
+static void dht_collect_job() {
+    uint32_t elapsed_us = time_us_64() - started_us;
+    if (dma_channel_is_busy(dht.dma_chan)) {
+        if (elapsed_us < DHT_TIMEOUT_MS * 1000) {
+            sched_wake(collect_job, DHT_POLL_MS);
+            return;
+        }
+        // no reply - reset the driver rather than wait in dht_finish_measurement_blocking()
+        ++stats.failures;
+        ++stats.timeouts;
+        printf("WARNING: DHT Sensor read timed out\n");
+        dht_deinit(&dht);
+        dht_init(&dht, DHT_MODEL, pio1, DHT_DATA_PIN, true);
+        return;
+    }
+    float humidity = 0.0f;
+    float temperature = 0.0f;
+    dht_result_t result = dht_finish_measurement_blocking(&dht, &humidity, &temperature);  // already complete
+    if (result == DHT_RESULT_OK) {
+        stats.latency_us_last = elapsed_us;
+        if (elapsed_us > stats.latency_us_max) stats.latency_us_max = elapsed_us;
+        stats.latency_us_total += elapsed_us;
+        add_sample(temperature + DHT_TEMP_OFFSET, humidity + DHT_HUM_OFFSET);
+    } else {
+        ++stats.failures;
+        if (result == DHT_RESULT_TIMEOUT) ++stats.timeouts;
+        printf("WARNING: DHT Sensor read failure\n");
+    }
+}
+
+void sensors_setup() {
+    // set up the AM2302/DHT22 Temp & Hum sensor
+    dht_init(&dht, DHT_MODEL, pio1, DHT_DATA_PIN, true);
+    sched_add("dht", DHT_SAMPLE_PERIOD_MS, DHT_FIRST_SAMPLE_MS, dht_start_job);
+    collect_job = sched_add("dht collect", 0, 0, dht_collect_job);
+}
+
+void sensors_get_stats(sensor_stats_t *s) {
+    *s = stats;
+}
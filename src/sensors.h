@@ -0,0 +1,43 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdint.h>
+
+#define DHT_DATA_PIN 7                  // GPIO7 - physical pin 10
+#define DHT_SAMPLE_PERIOD_MS (10 * 1000)
+#define DHT_FIRST_SAMPLE_MS 1000        // we try to get an inital reading quite quickly
+#define DHT_READ_MS 30                  // start pulse plus 40 data bits take about 25ms
+#define DHT_POLL_MS 5                   // ... then check this often
+#define DHT_TIMEOUT_MS 100              // ... until giving up on the reading
+#define DHT_TEMP_OFFSET -1.0            // Some units need calibration and an offset applied
+#define DHT_HUM_OFFSET -5
+
+// Readings are filtered by a median over the last few samples (rejecting glitches), then an EMA
+#define SAMPLE_RING_LEN 5               // samples the median is taken over
+#define SAMPLE_EMA_ALPHA 0.3f           // weight of each new median in the average
+
+// The filtered values are published when they move by at least the deadband, or else every heartbeat
+#define TEMP_DEADBAND 0.2f              // degrees C
+#define HUM_DEADBAND 1.0f               // % RH
+#define PUBLISH_HEARTBEAT_MS (10 * 60 * 1000)
+
+typedef struct {
+    uint32_t reads;             // measurements started
+    uint32_t failures;          // ... that timed out or failed their checksum
+    uint32_t timeouts;          // ... of which timed out
+    uint32_t latency_us_last;   // from starting a measurement to its result
+    uint32_t latency_us_max;
+    uint64_t latency_us_total;  // over successful reads
+    uint32_t published;         // filtered readings published
+    uint32_t suppressed;        // ... not published, being within the deadband
+} sensor_stats_t;
+
+void sensors_setup();
+void sensors_get_stats(sensor_stats_t *stats);
+
+#endif
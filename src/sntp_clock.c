@@ -0,0 +1,167 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "sntp_clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "lwip/apps/sntp.h"
+#include "pico/cyw43_arch.h"
+#include "pico/time.h"
+
+#include "info_items.h"
+
+/* The clock is kept as the UTC time of the last SNTP update plus the microsecond timer since then,
+   scaled by the measured crystal error.  Unlike the RTC this has sub-second resolution, so the
+   items can be redrawn just as each second starts. */
+
+typedef enum { FMT_NONE, FMT_HHMMSS, FMT_HHMM, FMT_DATE } clock_fmt_t;
+
+#define CLOCK_TEXT_MAX 12
+
+static clock_fmt_t item_fmt[URGENT_TEXT_SLOT];
+static char item_text[URGENT_TEXT_SLOT][CLOCK_TEXT_MAX];
+static bool have_items;
+
+static bool synced;
+static uint64_t sync_utc_us;    // UTC microseconds since 1970 at the last update
+static uint64_t sync_timer_us;  // time_us_64() at the last update
+static clock_stats_t stats;
+
+// The rate is only re-estimated over long intervals, where network jitter is small in comparison
+#define RATE_MIN_INTERVAL_US (10 * 60 * 1000000LL)
+
+static void clock_tick(async_context_t *context, async_at_time_worker_t *worker);
+static async_at_time_worker_t tick_worker = { .do_work = clock_tick };
+static bool ticking;
+
+static uint64_t utc_us_at(uint64_t timer_us) {
+    int64_t elapsed = timer_us - sync_timer_us;
+    return sync_utc_us + elapsed + elapsed * stats.rate_ppm / 1000000;
+}
+
+/* days_from_civil gives the days since 1970-01-01 of a Gregorian date (after Howard Hinnant) */
+static int32_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/* last_sunday gives the day number of the last Sunday of a 31-day month */
+static int32_t last_sunday(int year, int month) {
+    int32_t last = days_from_civil(year, month, 31);
+    return last - (last + 4) % 7;   // 1970-01-01 was a Thursday
+}
+
+static time_t local_seconds(time_t utc) {
+    time_t local = utc + CLOCK_UTC_OFFSET_MINS * 60;
+#if CLOCK_EU_DST
+    struct tm tm;
+    gmtime_r(&utc, &tm);
+    int year = tm.tm_year + 1900;
+    // summer time runs from 01:00 UTC on the last Sunday in March to 01:00 UTC on the last Sunday in October
+    time_t start = (time_t)last_sunday(year, 3) * 86400 + 3600;
+    time_t end = (time_t)last_sunday(year, 10) * 86400 + 3600;
+    if ((utc >= start) && (utc < end)) local += 3600;
+#endif
+    return local;
+}
+
+static void schedule_tick() {
+    uint64_t now = time_us_64();
+    uint64_t to_next = 1000000 - utc_us_at(now) % 1000000;
+    ticking = async_context_add_at_time_worker_at(cyw43_arch_async_context(), &tick_worker,
+                                                  from_us_since_boot(now + to_next));
+}
+
+/* clock_tick runs at the start of each second, updating any clock item whose text has changed */
+static void clock_tick(__attribute__((unused)) async_context_t *context,
+                       __attribute__((unused)) async_at_time_worker_t *worker) {
+    // round to the nearest second in case the timer fired a little early
+    time_t utc = (utc_us_at(time_us_64()) + 500000) / 1000000;
+    time_t local = local_seconds(utc);
+    struct tm tm;
+    gmtime_r(&local, &tm);
+    bool changed = false;
+    for (int id = 0; id < INFO_ITEM_COUNT; ++id) {
+        char text[CLOCK_TEXT_MAX];
+        switch (item_fmt[id]) {
+        case FMT_HHMMSS: strftime(text, sizeof(text), "%H:%M:%S", &tm); break;
+        case FMT_HHMM:   strftime(text, sizeof(text), "%H:%M", &tm); break;
+        case FMT_DATE:   strftime(text, sizeof(text), "%a %d %b", &tm); break;
+        default: continue;
+        }
+        if (strcmp(text, item_text[id]) != 0) {
+            strcpy(item_text[id], text);
+            show_data(id, text, strlen(text));
+            changed = true;
+        }
+    }
+    if (changed) {
+        ++stats.ticks;
+        info_render_now();
+    }
+    schedule_tick();
+}
+
+/* clock_sntp_set is called by lwIP (see SNTP_SET_SYSTEM_TIME_US in lwipopts.h) with each update */
+void clock_sntp_set(uint32_t sec, uint32_t us) {
+    uint64_t now = time_us_64();
+    uint64_t utc_us = (uint64_t)sec * 1000000 + us;
+    if (synced) {
+        int64_t error_us = utc_us - utc_us_at(now);
+        int64_t elapsed = now - sync_timer_us;
+        if (elapsed >= RATE_MIN_INTERVAL_US) {
+            // apply half the apparent rate error, to damp the effect of network jitter
+            int32_t ppm = stats.rate_ppm + error_us * 1000000 / elapsed / 2;
+            if (ppm > CLOCK_MAX_PPM) ppm = CLOCK_MAX_PPM;
+            if (ppm < -CLOCK_MAX_PPM) ppm = -CLOCK_MAX_PPM;
+            stats.rate_ppm = ppm;
+        }
+        stats.last_error_us = error_us;
+        if (llabs(error_us) > stats.max_error_us) stats.max_error_us = llabs(error_us);
+    } else {
+        printf("INFO: Clock set by SNTP\n");
+    }
+    sync_utc_us = utc_us;
+    sync_timer_us = now;
+    synced = true;
+    ++stats.syncs;
+    if (have_items && !ticking) schedule_tick();
+}
+
+/* clock_setup finds the layout's clock items and, if there are any, starts SNTP */
+void clock_setup() {
+    for (int id = 0; id < INFO_ITEM_COUNT; ++id) {
+        const char *topic = info_items[id].topic;
+        item_fmt[id] = FMT_NONE;
+        if (!is_clock_topic(topic)) continue;
+        bool first = true;      // items sharing a topic are all drawn via the first
+        for (int i = 0; i < id; ++i) {
+            if (strcmp(info_items[i].topic, topic) == 0) first = false;
+        }
+        if (!first) continue;
+        if (strcmp(topic, CLOCK_HHMMSS) == 0) item_fmt[id] = FMT_HHMMSS;
+        else if (strcmp(topic, CLOCK_HHMM) == 0) item_fmt[id] = FMT_HHMM;
+        else if (strcmp(topic, CLOCK_DATE) == 0) item_fmt[id] = FMT_DATE;
+        else printf("WARNING: Unknown clock item %s\n", topic);
+        if (item_fmt[id] != FMT_NONE) have_items = true;
+    }
+    if (!have_items) return;
+    cyw43_arch_lwip_begin();
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, NTP_SERVER);
+    sntp_init();
+    cyw43_arch_lwip_end();
+}
+
+void clock_get_stats(clock_stats_t *s) {
+    *s = stats;
+}
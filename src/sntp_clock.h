@@ -0,0 +1,47 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SNTP_CLOCK_H
+#define SNTP_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// When true, the time and date items are drawn from a local clock kept by SNTP instead of MQTT topics
+#define USE_LOCAL_CLOCK true
+
+#define NTP_SERVER "pool.ntp.org"
+
+// Local time - CET, with EU summer time (last Sunday in March to last Sunday in October)
+#define CLOCK_UTC_OFFSET_MINS 60
+#define CLOCK_EU_DST true
+
+// Crystal error beyond which the rate correction is not trusted
+#define CLOCK_MAX_PPM 500
+
+// Pseudo-topics for layout items drawn by the local clock - '$' topics are never published by clients
+#define CLOCK_TOPIC_PREFIX "$clock/"
+#define CLOCK_HHMMSS CLOCK_TOPIC_PREFIX "hhmmss"     // 12:34:56
+#define CLOCK_HHMM   CLOCK_TOPIC_PREFIX "hhmm"       // 12:34
+#define CLOCK_DATE   CLOCK_TOPIC_PREFIX "date"       // Sat 17 Oct
+
+typedef struct {
+    uint32_t syncs;             // SNTP updates received
+    int32_t last_error_us;      // how far the clock had drifted at the last update
+    int32_t max_error_us;       // ... largest such error (magnitude)
+    int32_t rate_ppm;           // crystal error now being corrected for
+    uint32_t ticks;             // second boundaries that changed a clock item
+} clock_stats_t;
+
+static inline bool is_clock_topic(const char *topic) {
+    return strncmp(topic, CLOCK_TOPIC_PREFIX, sizeof(CLOCK_TOPIC_PREFIX) - 1) == 0;
+}
+
+void clock_setup();
+void clock_sntp_set(uint32_t sec, uint32_t us);
+void clock_get_stats(clock_stats_t *stats);
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/* Timing for the host benchmarks.  The figures only compare the old and new code with each
+   other on the same host - the RP2040 is far slower, and its memory behaves differently.
+   A benchmark's optional argument scales its run time; ctest runs each with a small one. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static long bench_scale = 100;
+static volatile uint32_t bench_sink;   // results go here so the work is not optimised away
+
+static inline void bench_args(int argc, char *argv[]) {
+    if (argc > 1) bench_scale = atol(argv[1]);
+    if (bench_scale < 1) bench_scale = 1;
+}
+
+static inline uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* BENCH times ops repetitions of stmt, returning the nanoseconds per repetition */
+#define BENCH(ops, stmt) ({ \
+        long n_ = (ops); \
+        uint64_t t0_ = bench_ns(); \
+        for (long i_ = 0; i_ < n_; ++i_) { stmt; } \
+        (double)(bench_ns() - t0_) / n_; \
+    })
+
+static inline void bench_compare(const char *what, const char *unit, double old_ns, double new_ns) {
+    printf("%-32s old %10.1f ns/%s  new %10.1f ns/%s  (%.2fx)\n", what, old_ns, unit, new_ns, unit, old_ns / new_ns);
+}
+
+#endif
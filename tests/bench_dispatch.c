@@ -0,0 +1,154 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * The show_data() dispatch path with synthetic payloads: the string-typed info items and
+ * strcmp dispatch used before, against info_items.c as it is now.  Drawing is left out - both
+ * sides end in a stand-in for the glyph routines, so only building the text and choosing how to
+ * draw it is timed.  The new side holds the text until the render tick, so it is timed both as
+ * messages arrive (several to a tick) and with info_render_now() drawing after every one.
+*/
+
+#include <string.h>
+
+#include "fake_pico.h"
+#include "bench.h"
+
+#include "info_items.h"
+#include "lcd.h"
+#include "mqtt.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "sntp_clock.h"
+
+/* Just enough of the rest of the firmware to link info_items.c */
+
+char __StackLimit, __bss_end__;
+
+void lcd_invalidate() {}
+void lcd_invalidate_since(uint32_t since_us) { (void)since_us; }
+void lcd_off() {}
+void lcd_on() {}
+void lcd_brighten() {}
+void lcd_darken() {}
+void lcd_get_stats(lcd_stats_t *s) { memset(s, 0, sizeof(*s)); }
+void clock_get_stats(clock_stats_t *s) { memset(s, 0, sizeof(*s)); }
+int sched_job_count() { return 0; }
+void sched_get_job_stats(int job, sched_job_stats_t *s) { (void)job; memset(s, 0, sizeof(*s)); }
+void sensors_get_stats(sensor_stats_t *s) { memset(s, 0, sizeof(*s)); }
+void mqtt_get_rx_stats(mqtt_rx_stats_t *s) { memset(s, 0, sizeof(*s)); }
+void mqtt_get_pub_stats(mqtt_pub_stats_t *s) { memset(s, 0, sizeof(*s)); }
+void mqtt_get_link_stats(mqtt_link_stats_t *s) { memset(s, 0, sizeof(*s)); }
+/* The render tick is never left to run, so its worker need not be kept - the fake's list would be timed too */
+bool async_context_add_at_time_worker_in_ms(async_context_t *context, async_at_time_worker_t *worker, uint32_t ms) {
+    (void)context; (void)worker; (void)ms;
+    return true;
+}
+
+bool async_context_remove_at_time_worker(async_context_t *context, async_at_time_worker_t *worker) {
+    (void)context; (void)worker;
+    return true;
+}
+
+void text_extent(const text_style_t *st, int len, int *width, int *height) {
+    (void)st; *width = len; *height = 1;
+}
+
+/* Both sides finish here instead of drawing */
+__attribute__((noinline)) static void draw_stub(const char *msg, uint16_t x, uint16_t y, colour_t fg, colour_t bg, int style) {
+    bench_sink += msg[0] + x + y + fg + bg + style;
+}
+
+void show_text_item(image_t img, text_item_t items[MAX_TEXT_ITEMS], int slot,
+                    char msg[], uint16_t x, uint16_t y, colour_t fg, colour_t bg, const text_style_t *st) {
+    (void)img; (void)items; (void)slot;
+    draw_stub(msg, x, y, fg, bg, st->font * 4 + st->scale);
+}
+
+/* The info items as they were, with every setting a string */
+typedef struct {
+    const char *prefix, *suffix;
+    uint16_t x, y;
+    const char *fg, *bg;
+    const char *font;
+    int scale;
+} old_item_t;
+
+static old_item_t old_items[URGENT_TEXT_SLOT];
+
+static const char *colour_names[PALETTE_SIZE] = {
+    [BLACK] = "BLACK", [RED] = "RED", [GREEN] = "GREEN", [BLUE] = "BLUE",
+    [WHITE] = "WHITE", [CYAN] = "CYAN", [MAGENTA] = "MAGENTA", [YELLOW] = "YELLOW",
+};
+
+static colour_t old_string2rgb(const char *s) {
+    if (strcmp("BLACK", s) == 0) return BLACK;
+    if (strcmp("RED", s) == 0) return RED;
+    if (strcmp("GREEN", s) == 0) return GREEN;
+    if (strcmp("BLUE", s) == 0) return BLUE;
+    if (strcmp("WHITE", s) == 0) return WHITE;
+    if (strcmp("CYAN", s) == 0) return CYAN;
+    if (strcmp("MAGENTA", s) == 0) return MAGENTA;
+    if (strcmp("YELLOW", s) == 0) return YELLOW;
+    // failsafe
+    return WHITE;
+}
+
+/* old_show_data is the info item branch of show_data() as it was */
+__attribute__((noinline)) static void old_show_data(int id, const char *data, int len) {
+    const old_item_t *it = &old_items[id];
+    char info[40] = "";
+    if (strlen(it->prefix) > 0) strcat(info, it->prefix);
+    strncat(info, data, len);
+    if (strlen(it->suffix) > 0) strcat(info, it->suffix);
+    if (strcmp(it->font, "3x5") == 0) {
+        if (it->scale == 1) {
+            draw_stub(info, it->x, it->y, old_string2rgb(it->fg), old_string2rgb(it->bg), 1);
+        } else {
+            draw_stub(info, it->x, it->y, old_string2rgb(it->fg), old_string2rgb(it->bg), 2);
+        }
+    } else {
+        switch (it->scale) {
+            case 1:
+                draw_stub(info, it->x, it->y, old_string2rgb(it->fg), old_string2rgb(it->bg), 5);
+                break;
+            case 2:
+                draw_stub(info, it->x, it->y, old_string2rgb(it->fg), old_string2rgb(it->bg), 6);
+                break;
+            case 4:
+                draw_stub(info, it->x, it->y, old_string2rgb(it->fg), old_string2rgb(it->bg), 8);
+                break;
+        }
+    }
+}
+
+static const char *payloads[] = {"12:34:56", "Sat 17 Oct", "21.5", "-3", "1.1712", "99"};
+#define N_PAYLOADS ((int)(sizeof(payloads) / sizeof(payloads[0])))
+
+static int payload_lens[N_PAYLOADS];
+static int ids[64];         // the item each synthetic message is for - only whole-payload items
+
+int main(int argc, char *argv[]) {
+    bench_args(argc, argv);
+    static image_t img;
+    info_setup(&img);
+    int n_ids = 0;
+    for (int id = 0; id < INFO_ITEM_COUNT && id < URGENT_TEXT_SLOT; ++id) {
+        const info_item_t *d = &info_items[id];
+        old_items[id] = (old_item_t){d->prefix, d->suffix, d->x, d->y, colour_names[d->fg], colour_names[d->bg],
+                                     (d->style.font == FONT_3X5) ? "3x5" : "5x7", d->style.scale};
+        if (d->field_len == 0) ids[n_ids++] = id;
+    }
+    for (int p = 0; p < N_PAYLOADS; ++p) payload_lens[p] = strlen(payloads[p]);
+    if (n_ids == 0) return 1;
+
+    long ops = bench_scale * 10000;
+    double o = BENCH(ops, int p = i_ % N_PAYLOADS; old_show_data(ids[i_ % n_ids], payloads[p], payload_lens[p]));
+    double n = BENCH(ops, int p = i_ % N_PAYLOADS; show_data(ids[i_ % n_ids], payloads[p], payload_lens[p]));
+    bench_compare("show_data, drawn at the tick", "msg", o, n);
+    n = BENCH(ops, int p = i_ % N_PAYLOADS; show_data(ids[i_ % n_ids], payloads[p], payload_lens[p]); info_render_now());
+    bench_compare("show_data, drawn every message", "msg", o, n);
+    return 0;
+}
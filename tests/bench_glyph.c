@@ -0,0 +1,40 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * Text drawing speed of show_string() against the per-pixel routines it replaced (ref_glyphs.h),
+ * for each text style, including the background clear and the dirty region bookkeeping.
+*/
+
+#include <string.h>
+
+#include "fake_pico.h"
+#include "bench.h"
+
+#include "ref_glyphs.h"
+
+static mutex_t image_mutex;
+static image_t img;
+static rect_t rects[MAX_DIRTY_RECTS];
+
+static void bench_style(const char *what, const char *msg, font_t font, int scale) {
+    int len = strlen(msg);
+    double o = BENCH(bench_scale * 100, ref_string(img, msg, 1, 40, YELLOW, BLACK, font, scale); take_dirty_rects(rects));
+    double n = BENCH(bench_scale * 100, show_string(img, (char *)msg, 1, 40, YELLOW, BLACK, font, scale); take_dirty_rects(rects));
+    bench_compare(what, "glyph", o / len, n / len);
+    printf("%-32s old %10.0f glyphs/s      new %10.0f glyphs/s\n", "", 1e9 * len / o, 1e9 * len / n);
+}
+
+int main(int argc, char *argv[]) {
+    bench_args(argc, argv);
+    graphics_init(&image_mutex);
+    bench_style("3x5 text", "12:34:56 Sat 17 Oct", FONT_3X5, 1);
+    bench_style("6x10 text", "12:34:56 Sat 17 Oct", FONT_3X5, 2);
+    bench_style("5x7 text", "12:34:56 Sat 17 Oct", FONT_5X7, 1);
+    bench_style("10x14 text", "12:34:56 Sat 17 Oct", FONT_5X7, 2);
+    bench_style("40x56 text", "DOOR OPEN!", FONT_5X7, 4);
+    bench_sink += image_get(img, 1, 40);
+    return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * Glyph blits and scan-out with the column-major framebuffer used before, and the row-major one
+ * in image.h.  Both sides use the same per-pixel glyph code (as graphics.c had when the layout
+ * changed) so that only the memory layout differs; blocks and scan-out are as each layout's
+ * version of graphics.c and lcd.c did them.
+*/
+
+#include <string.h>
+
+#include "bench.h"
+#include "font_5x7.h"
+#include "image.h"
+
+// The previous layout: columns of pixels, even y in the low nibble
+typedef uint8_t col_image_t[LCD_WIDTH][LCD_HEIGHT / 2];
+
+static inline void col_set(col_image_t img, int x, int y, colour_t c) {
+    uint8_t *p = &img[x][y >> 1];
+    if (y & 1) *p = (*p & 0x0f) | (c << 4);
+    else       *p = (*p & 0xf0) | c;
+}
+
+static inline colour_t col_get(col_image_t img, int x, int y) {
+    return (y & 1) ? (img[x][y >> 1] >> 4) : (img[x][y >> 1] & 0x0f);
+}
+
+static col_image_t col_img;
+static image_t row_img;
+
+const rgb_t palette[PALETTE_SIZE] = {
+    [RED] = {3, 0, 0}, [GREEN] = {0, 3, 0}, [BLUE] = {0, 0, 3}, [WHITE] = {3, 3, 3},
+    [CYAN] = {0, 3, 3}, [MAGENTA] = {3, 0, 3}, [YELLOW] = {3, 3, 0},
+};
+static uint8_t palette_wire[PALETTE_SIZE][3];
+static uint8_t snap[4 * LCD_HEIGHT * 3];
+
+/* show_5x7_char as it was, for either layout */
+#define GLYPH_5X7(set, img, c, fg, bg, x, y) \
+    for (int col = 0; col < 5; ++col) { \
+        for (int row = 0; row < 7; ++row) { \
+            set(img, (x) + col, (y) + row, ((font_5x7[c][col] & (1 << row)) != 0) ? (fg) : (bg)); \
+        } \
+    }
+
+static void col_5x7(unsigned char c, int x, int y) { GLYPH_5X7(col_set, col_img, c, YELLOW, BLACK, x, y) }
+static void row_5x7(unsigned char c, int x, int y) { GLYPH_5X7(image_set, row_img, c, YELLOW, BLACK, x, y) }
+
+/* show_block before and after */
+static void col_block(int x, int y, int w, int h, colour_t c) {
+    for (int ix = x; ix < x + w; ++ix) {
+        for (int iy = y; iy < y + h; ++iy) col_set(col_img, ix, iy, c);
+    }
+}
+
+static void row_block(int x, int y, int w, int h, colour_t c) {
+    for (int iy = y; iy < y + h; ++iy) {
+        int ix = x, n = w;
+        if (ix & 1) { image_set(row_img, ix++, iy, c); --n; }
+        memset(&row_img[iy][ix >> 1], (c << 4) | c, n >> 1);
+        if (n & 1) image_set(row_img, ix + n - 1, iy, c);
+    }
+}
+
+/* show_40x56_char drew each lit font pixel as an 8x8 block */
+static void col_40x56(unsigned char c, int x, int y) {
+    for (int row = 0; row < 7; row++) {
+        for (int col = 0; col < 5; col++) {
+            if (font_5x7[c][col] & (1 << row)) col_block(x + col * 8, y + row * 8, 8, 8, YELLOW);
+        }
+    }
+}
+
+static void row_40x56(unsigned char c, int x, int y) {
+    for (int row = 0; row < 7; row++) {
+        for (int col = 0; col < 5; col++) {
+            if (font_5x7[c][col] & (1 << row)) row_block(x + col * 8, y + row * 8, 8, 8, YELLOW);
+        }
+    }
+}
+
+/* Scan-out of a region into wire-format snapshots, as lcd_push_rect() did for each layout:
+   the panel was addressed column by column before, and row by row now */
+static uint32_t col_scan(int rx, int ry, int rw, int rh) {
+    uint32_t sum = 0;
+    int cols_per_buf = sizeof(snap) / (rh * 3);
+    for (int x = rx; x < rx + rw; x += cols_per_buf) {
+        int x_end = (x + cols_per_buf < rx + rw) ? x + cols_per_buf : rx + rw;
+        uint8_t *p = snap;
+        for (int lx = x; lx < x_end; lx++) {
+            for (int y = ry; y < ry + rh; y++) {
+                const uint8_t *w = palette_wire[col_get(col_img, lx, y)];
+                *p++ = w[0]; *p++ = w[1]; *p++ = w[2];
+            }
+        }
+        sum += snap[0] + p[-1];
+    }
+    return sum;
+}
+
+static uint32_t row_scan(int rx, int ry, int rw, int rh) {
+    uint32_t sum = 0;
+    int rows_per_buf = sizeof(snap) / (rw * 3);
+    for (int y = ry; y < ry + rh; y += rows_per_buf) {
+        int y_end = (y + rows_per_buf < ry + rh) ? y + rows_per_buf : ry + rh;
+        uint8_t *p = snap;
+        for (int ly = y; ly < y_end; ly++) {
+            for (int x = rx; x < rx + rw; x++) {
+                const uint8_t *w = palette_wire[image_get(row_img, x, ly)];
+                *p++ = w[0]; *p++ = w[1]; *p++ = w[2];
+            }
+        }
+        sum += snap[0] + p[-1];
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[]) {
+    bench_args(argc, argv);
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        palette_wire[i][0] = palette[i].b << 7;
+        palette_wire[i][1] = palette[i].g << 7;
+        palette_wire[i][2] = palette[i].r << 7;
+    }
+    const char *text = "Sat 17 Oct 12:34:56 21.3C 45% Hello!";
+    int len = strlen(text);
+
+    double o = BENCH(bench_scale * 200, for (int k = 0; k < len; k++) col_5x7(text[k], 3 + k * 6, 100));
+    double n = BENCH(bench_scale * 200, for (int k = 0; k < len; k++) row_5x7(text[k], 3 + k * 6, 100));
+    bench_compare("5x7 glyph", "glyph", o / len, n / len);
+
+    o = BENCH(bench_scale * 50, for (int k = 0; k < 10; k++) col_40x56(text[k], k * 46, 250));
+    n = BENCH(bench_scale * 50, for (int k = 0; k < 10; k++) row_40x56(text[k], k * 46, 250));
+    bench_compare("40x56 glyph", "glyph", o / 10, n / 10);
+
+    o = BENCH(bench_scale * 50, col_block(0, 250, 460, 56, BLACK));
+    n = BENCH(bench_scale * 50, row_block(0, 250, 460, 56, BLACK));
+    bench_compare("460x56 background block", "block", o, n);
+
+    o = BENCH(bench_scale * 20, bench_sink += col_scan(0, 250, LCD_WIDTH, 56));
+    n = BENCH(bench_scale * 20, bench_sink += row_scan(0, 250, LCD_WIDTH, 56));
+    bench_compare("480x56 text strip scan-out", "strip", o, n);
+
+    o = BENCH(bench_scale * 2, bench_sink += col_scan(0, 0, LCD_WIDTH, LCD_HEIGHT));
+    n = BENCH(bench_scale * 2, bench_sink += row_scan(0, 0, LCD_WIDTH, LCD_HEIGHT));
+    bench_compare("full frame scan-out", "frame", o, n);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * Topic routing for a replayed broker topic mix: the strcmp scan used before against the hash
+ * table in mqtt.c.  The mix stands in for what arrives subscribed to rgbmatrix/# - a few hundred
+ * topics from other devices that the panel ignores, with the topics it shows mixed in.
+*/
+
+#include <string.h>
+
+#include "fake_pico.h"
+#include "bench.h"
+
+#include "../src/mqtt.c"
+
+#define LAYOUT_ITEM INFO_ITEM
+
+const info_item_t info_items[] = { LAYOUT_ITEMS };
+const int INFO_ITEM_COUNT = sizeof(info_items) / sizeof(info_items[0]);
+
+void show_data(int id, const char *data, int len) { (void)id; (void)data; (void)len; }
+
+/* old_route is mqtt_incoming_publish_cb() as it was */
+__attribute__((noinline)) static int old_route(const char *topic) {
+    if (strcmp(topic, URGENT_TOPIC) == 0) return ID_URGENT;
+    for (int i = 0; i < INFO_ITEM_COUNT; ++i) {
+        if (strcmp(topic, info_items[i].topic) == 0) return i;
+    }
+    if (strcmp(topic, MQTT_CONTROL_TOPIC) == 0) return ID_CONTROL;
+    return ID_UNKNOWN;
+}
+
+__attribute__((noinline)) static int new_route(const char *topic) {
+    return route_topic(topic);
+}
+
+#define OTHER_TOPICS 300
+#define REPLAY_LEN 4096
+
+static char other[OTHER_TOPICS][64];
+static const char *replay[REPLAY_LEN];
+static const char *replay_shown[REPLAY_LEN];   // only the topics the panel uses
+
+static void make_replay() {
+    const char *rooms[] = {"Pauls_Studio", "kitchen", "lounge", "office", "garage", "bedroom1", "bedroom2", "hall",
+                           "bathroom", "loft"};
+    const char *kinds[] = {"temperature", "humidity", "pressure", "battery", "linkquality", "motion", "contact",
+                           "illuminance", "power", "energy"};
+    int n = 0;
+    for (int r = 0; r < 10; ++r) {
+        for (int k = 0; k < 10; ++k) {
+            snprintf(other[n++], sizeof(other[0]), "rgbmatrix/%s/%s", rooms[r], kinds[k]);
+            snprintf(other[n++], sizeof(other[0]), "rgbmatrix/zigbee/0x00158d000%04x/%s", r * 16 + k, kinds[k]);
+            snprintf(other[n++], sizeof(other[0]), "rgbmatrix/%s_%s", rooms[r], kinds[k]);
+        }
+    }
+    const char *shown[MAX_TEXT_ITEMS + 2];
+    int n_shown = 0;
+    for (int i = 0; i < INFO_ITEM_COUNT; ++i) {
+        if (!is_clock_topic(info_items[i].topic)) shown[n_shown++] = info_items[i].topic;
+    }
+    shown[n_shown++] = URGENT_TOPIC;
+    shown[n_shown++] = MQTT_CONTROL_TOPIC;
+    srand(1);
+    for (int i = 0; i < REPLAY_LEN; ++i) {
+        // about one message in ten is for the panel
+        replay[i] = ((rand() % 10) == 0) ? shown[rand() % n_shown] : other[rand() % OTHER_TOPICS];
+        replay_shown[i] = shown[rand() % n_shown];
+    }
+    for (int i = 0; i < REPLAY_LEN; ++i) {
+        if ((old_route(replay[i]) != new_route(replay[i])) || (old_route(replay_shown[i]) != new_route(replay_shown[i]))) {
+            printf("%s or %s routed differently\n", replay[i], replay_shown[i]);
+            exit(1);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench_args(argc, argv);
+    mqtt_setup_client();
+    make_replay();
+    long ops = bench_scale * 20000;
+    double o = BENCH(ops, bench_sink += old_route(replay[i_ % REPLAY_LEN]));
+    double n = BENCH(ops, bench_sink += new_route(replay[i_ % REPLAY_LEN]));
+    bench_compare("topic routing, broker mix", "msg", o, n);
+    printf("%-32s old %10.0f msgs/s        new %10.0f msgs/s\n", "", 1e9 / o, 1e9 / n);
+    o = BENCH(ops, bench_sink += old_route(replay_shown[i_ % REPLAY_LEN]));
+    n = BENCH(ops, bench_sink += new_route(replay_shown[i_ % REPLAY_LEN]));
+    bench_compare("topic routing, shown topics only", "msg", o, n);
+    return 0;
+}
@@ -0,0 +1,244 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "fake_broker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SUBSCRIPTIONS 64
+#define MAX_TOPIC 96
+#define MAX_PAYLOAD 1100
+
+typedef enum { REQ_CONNECT, REQ_SUBSCRIBE, REQ_PUBLISH } req_type_t;
+
+typedef struct {
+    req_type_t type;
+    mqtt_request_cb_t cb;
+    void *arg;
+    char topic[MAX_TOPIC];      // subscriptions
+} request_t;
+
+struct mqtt_client_s {
+    bool connected;
+    bool connecting;
+    mqtt_connection_cb_t connection_cb;
+    void *connection_arg;
+    mqtt_incoming_publish_cb_t pub_cb;
+    mqtt_incoming_data_cb_t data_cb;
+    void *inpub_arg;
+};
+
+static mqtt_client_t the_client;
+static request_t requests[MQTT_REQ_MAX_IN_FLIGHT];
+static int n_requests;
+static char subscriptions[MAX_SUBSCRIPTIONS][MAX_TOPIC];
+static int n_subscriptions;
+static bool running = true;
+static bool bad_address;
+static int fragment_size;
+static fake_broker_stats_t stats;
+static char last_topic[MAX_TOPIC];
+static char last_payload[MAX_PAYLOAD];
+static bool have_last;
+
+/* packet_size gives the bytes on the wire of a packet with 'remaining' bytes after the fixed header */
+static uint32_t packet_size(uint32_t remaining) {
+    uint32_t n = 2;
+    for (uint32_t r = remaining; r >= 128; r /= 128) ++n;
+    return n + remaining;
+}
+
+static uint32_t publish_size(const char *topic, int payload_len) {
+    return packet_size(2 + strlen(topic) + payload_len);     // QoS 0 - no packet identifier
+}
+
+/* matches applies an MQTT topic filter, with + and # wildcards */
+static bool matches(const char *filter, const char *topic) {
+    while (true) {
+        if (*filter == '#') return true;
+        if (*filter == '+') {
+            ++filter;
+            while (*topic && (*topic != '/')) ++topic;
+            continue;
+        }
+        if (*filter != *topic) return false;
+        if (*filter == '\0') return true;
+        ++filter;
+        ++topic;
+    }
+}
+
+static void drop_connection(mqtt_connection_status_t why) {
+    bool was_up = the_client.connected || the_client.connecting;
+    the_client.connected = false;
+    the_client.connecting = false;
+    n_requests = 0;             // lwIP frees outstanding requests without calling them back
+    n_subscriptions = 0;        // clean session
+    if (was_up && (the_client.connection_cb != NULL)) {
+        the_client.connection_cb(&the_client, the_client.connection_arg, why);
+    }
+}
+
+void fake_broker_reset(void) {
+    memset(&the_client, 0, sizeof(the_client));
+    n_requests = 0;
+    n_subscriptions = 0;
+    running = true;
+    bad_address = false;
+    fragment_size = 0;
+    have_last = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void fake_broker_run(void) {
+    while (n_requests > 0) {
+        request_t r = requests[0];
+        memmove(&requests[0], &requests[1], --n_requests * sizeof(request_t));
+        switch (r.type) {
+            case REQ_CONNECT:
+                if (!running) {
+                    drop_connection(MQTT_CONNECT_DISCONNECTED);
+                    break;
+                }
+                stats.bytes_in += 4;    // CONNACK
+                the_client.connecting = false;
+                the_client.connected = true;
+                the_client.connection_cb(&the_client, the_client.connection_arg, MQTT_CONNECT_ACCEPTED);
+                break;
+            case REQ_SUBSCRIBE:
+                stats.bytes_in += 5;    // SUBACK, one return code
+                if (n_subscriptions < MAX_SUBSCRIPTIONS) strcpy(subscriptions[n_subscriptions++], r.topic);
+                if (r.cb != NULL) r.cb(r.arg, ERR_OK);
+                break;
+            case REQ_PUBLISH:
+                if (r.cb != NULL) r.cb(r.arg, ERR_OK);      // QoS 0 - done once sent
+                break;
+        }
+    }
+}
+
+static request_t *new_request(req_type_t type, mqtt_request_cb_t cb, void *arg) {
+    if (n_requests == MQTT_REQ_MAX_IN_FLIGHT) {
+        ++stats.refused;
+        return NULL;
+    }
+    request_t *r = &requests[n_requests++];
+    if (n_requests > (int)stats.max_in_flight) stats.max_in_flight = n_requests;
+    memset(r, 0, sizeof(*r));
+    r->type = type;
+    r->cb = cb;
+    r->arg = arg;
+    return r;
+}
+
+void fake_broker_publish(const char *topic, const char *payload) {
+    if (!the_client.connected) return;
+    bool wanted = false;
+    for (int i = 0; (i < n_subscriptions) && !wanted; ++i) wanted = matches(subscriptions[i], topic);
+    if (!wanted) return;
+    int len = strlen(payload);
+    stats.bytes_in += publish_size(topic, len);
+    ++stats.publishes_in;
+    if (the_client.pub_cb == NULL) return;
+    the_client.pub_cb(the_client.inpub_arg, topic, len);
+    int step = (fragment_size > 0) ? fragment_size : len;
+    int done = 0;
+    do {
+        int n = (len - done < step) ? len - done : step;
+        the_client.data_cb(the_client.inpub_arg, (const u8_t *)payload + done, n,
+                           (done + n == len) ? MQTT_DATA_FLAG_LAST : 0);
+        done += n;
+    } while (done < len);
+}
+
+void fake_broker_set_fragment(int fragment) { fragment_size = fragment; }
+
+void fake_broker_stop(void) {
+    running = false;
+    drop_connection(MQTT_CONNECT_DISCONNECTED);
+}
+
+void fake_broker_start(void) { running = true; }
+
+void fake_broker_bad_address(bool bad) { bad_address = bad; }
+
+bool fake_broker_subscribed(const char *topic) {
+    for (int i = 0; i < n_subscriptions; ++i) {
+        if (matches(subscriptions[i], topic)) return true;
+    }
+    return false;
+}
+
+int fake_broker_subscriptions(void) { return n_subscriptions; }
+int fake_broker_in_flight(void) { return n_requests; }
+void fake_broker_get_stats(fake_broker_stats_t *s) { *s = stats; }
+const char *fake_broker_last_topic(void) { return have_last ? last_topic : NULL; }
+const char *fake_broker_last_payload(void) { return have_last ? last_payload : NULL; }
+
+/* lwIP */
+
+int ip4addr_aton(const char *cp, ip_addr_t *addr) {
+    unsigned a, b, c, d;
+    if (bad_address || (sscanf(cp, "%u.%u.%u.%u", &a, &b, &c, &d) != 4)) return 0;
+    addr->addr = (a << 24) | (b << 16) | (c << 8) | d;
+    return 1;
+}
+
+mqtt_client_t *mqtt_client_new(void) {
+    return &the_client;
+}
+
+err_t mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ipaddr, u16_t port, mqtt_connection_cb_t cb,
+                          void *arg, const struct mqtt_connect_client_info_t *client_info) {
+    (void)ipaddr; (void)port;
+    if (client->connected || client->connecting) return ERR_CONN;   // lwIP: ERR_ISCONN
+    request_t *r = new_request(REQ_CONNECT, NULL, NULL);
+    if (r == NULL) return ERR_MEM;
+    client->connecting = true;
+    client->connection_cb = cb;
+    client->connection_arg = arg;
+    ++stats.connects;
+    stats.bytes_out += packet_size(10 + 2 + strlen(client_info->client_id));
+    return ERR_OK;
+}
+
+u8_t mqtt_client_is_connected(mqtt_client_t *client) {
+    return client->connected;
+}
+
+void mqtt_set_inpub_callback(mqtt_client_t *client, mqtt_incoming_publish_cb_t pub_cb,
+                             mqtt_incoming_data_cb_t data_cb, void *arg) {
+    client->pub_cb = pub_cb;
+    client->data_cb = data_cb;
+    client->inpub_arg = arg;
+}
+
+err_t mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_request_cb_t cb, void *arg, u8_t sub) {
+    (void)qos;
+    if (!client->connected) return ERR_CONN;
+    if (!sub) return ERR_OK;
+    request_t *r = new_request(REQ_SUBSCRIBE, cb, arg);
+    if (r == NULL) return ERR_MEM;
+    snprintf(r->topic, sizeof(r->topic), "%s", topic);
+    ++stats.subscribes;
+    stats.bytes_out += packet_size(2 + 2 + strlen(topic) + 1);
+    return ERR_OK;
+}
+
+err_t mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload, u16_t payload_length,
+                   u8_t qos, u8_t retain, mqtt_request_cb_t cb, void *arg) {
+    (void)qos; (void)retain;
+    if (!client->connected) return ERR_CONN;
+    request_t *r = new_request(REQ_PUBLISH, cb, arg);
+    if (r == NULL) return ERR_MEM;
+    ++stats.publishes_out;
+    stats.bytes_out += publish_size(topic, payload_length);
+    snprintf(last_topic, sizeof(last_topic), "%s", topic);
+    snprintf(last_payload, sizeof(last_payload), "%.*s", (int)payload_length, (const char *)payload);
+    have_last = true;
+    return ERR_OK;
+}
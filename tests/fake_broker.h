@@ -0,0 +1,57 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef FAKE_BROKER_H
+#define FAKE_BROKER_H
+
+/* A broker stand-in behind lwIP's MQTT client API, for the one client the firmware makes.
+   As with lwIP, connecting, subscribing and publishing only start a request, which uses one of
+   MQTT_REQ_MAX_IN_FLIGHT slots; its callback runs when fake_broker_run() lets the broker answer.
+   Every packet is counted at its MQTT 3.1.1 size, one topic to a SUBSCRIBE as lwIP sends them. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lwip/apps/mqtt.h"
+
+typedef struct {
+    uint32_t bytes_in;          // sent by the broker to the client
+    uint32_t bytes_out;         // sent by the client to the broker
+    uint32_t publishes_in;      // publishes delivered to the client
+    uint32_t publishes_out;     // publishes from the client
+    uint32_t subscribes;        // SUBSCRIBE packets
+    uint32_t connects;          // CONNECT packets
+    uint32_t refused;           // requests refused for want of a slot (ERR_MEM)
+    uint32_t max_in_flight;     // most requests outstanding at once
+} fake_broker_stats_t;
+
+// Forget the connection, subscriptions and counts, with the broker running
+void fake_broker_reset(void);
+
+// Answer every outstanding request (CONNACK, SUBACK, sent publishes) until none is left
+void fake_broker_run(void);
+
+// Publish from another client - delivered if the client is subscribed, in fragments of at most
+// 'fragment' bytes (0 for whole payloads)
+void fake_broker_publish(const char *topic, const char *payload);
+void fake_broker_set_fragment(int fragment);
+
+// Kill the broker: the connection drops, and attempts fail, until it is started again
+void fake_broker_stop(void);
+void fake_broker_start(void);
+
+// Make ip4addr_aton() fail, as for a bad BROKER_HOST
+void fake_broker_bad_address(bool bad);
+
+bool fake_broker_subscribed(const char *topic);
+int fake_broker_subscriptions(void);
+int fake_broker_in_flight(void);
+void fake_broker_get_stats(fake_broker_stats_t *stats);
+
+// The last publish from the client, or NULL
+const char *fake_broker_last_topic(void);
+const char *fake_broker_last_payload(void);
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "fake_dht.h"
+
+#include <string.h>
+
+#include "hardware/dma.h"
+#include "fake_pico.h"
+
+#define FAKE_DHT_DMA_CHAN 5
+
+static bool initialised;
+static bool measuring;
+static uint64_t reply_at_us;
+static dht_result_t reply_result;
+static float reply_temperature;
+static float reply_humidity;
+static uint32_t reply_us;
+static fake_dht_stats_t stats;
+
+void fake_dht_reset(void) {
+    initialised = false;
+    measuring = false;
+    memset(&stats, 0, sizeof(stats));
+    fake_dht_set_reply(DHT_RESULT_OK, 21.0f, 50.0f, 25000);
+}
+
+void fake_dht_set_reply(dht_result_t result, float temperature, float humidity, uint32_t us) {
+    reply_result = result;
+    reply_temperature = temperature;
+    reply_humidity = humidity;
+    reply_us = us;
+}
+
+void fake_dht_get_stats(fake_dht_stats_t *s) { *s = stats; }
+
+static bool busy() {
+    return measuring && (fake_now_us < reply_at_us);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return (channel == FAKE_DHT_DMA_CHAN) && busy();
+}
+
+/* pico_dht */
+
+void dht_init(dht_t *dht, dht_model_t model, PIO pio, uint8_t data_pin, bool pull_up) {
+    (void)pull_up;
+    if (initialised) ++stats.misuse;
+    memset(dht, 0, sizeof(*dht));
+    dht->pio = pio;
+    dht->model = model;
+    dht->data_pin = data_pin;
+    dht->dma_chan = FAKE_DHT_DMA_CHAN;
+    initialised = true;
+    measuring = false;
+    ++stats.inits;
+}
+
+/* dht_deinit releases the PIO state machine and DMA channel, aborting any transfer */
+void dht_deinit(dht_t *dht) {
+    (void)dht;
+    if (!initialised) ++stats.misuse;
+    if (busy()) ++stats.deinits_busy;
+    initialised = false;
+    measuring = false;
+    ++stats.deinits;
+}
+
+void dht_start_measurement(dht_t *dht) {
+    if (!initialised || busy()) ++stats.misuse;
+    dht->start_time = (uint32_t)fake_now_us;
+    measuring = true;
+    reply_at_us = (reply_us == FAKE_DHT_NO_REPLY) ? UINT64_MAX : fake_now_us + reply_us;
+    ++stats.starts;
+}
+
+/* dht_finish_measurement_blocking would wait for the DMA, so is only expected once it is done */
+dht_result_t dht_finish_measurement_blocking(dht_t *dht, float *humidity, float *temperature_c) {
+    (void)dht;
+    if (!measuring || busy()) {
+        ++stats.misuse;
+        return DHT_RESULT_TIMEOUT;
+    }
+    measuring = false;
+    ++stats.finishes;
+    if (reply_result == DHT_RESULT_OK) {
+        *humidity = reply_humidity;
+        *temperature_c = reply_temperature;
+    }
+    return reply_result;
+}
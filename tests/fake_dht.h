@@ -0,0 +1,38 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef FAKE_DHT_H
+#define FAKE_DHT_H
+
+/* A DHT22 stand-in behind pico_dht's interface, with the DMA channel it reads into.  Each
+   measurement's outcome is set beforehand: the channel stays busy (dma_channel_is_busy()) until
+   the sensor replies, reply_us after dht_start_measurement(), or for ever if it never does.
+   Misuse the real driver would not survive is counted rather than simulated. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico_dht/dht/include/dht.h"
+
+#define FAKE_DHT_NO_REPLY UINT32_MAX
+
+typedef struct {
+    uint32_t inits;
+    uint32_t deinits;
+    uint32_t deinits_busy;      // deinits aborting a transfer still in progress
+    uint32_t starts;
+    uint32_t finishes;
+    uint32_t misuse;            // starts or finishes while uninitialised, busy or idle, and double inits
+} fake_dht_stats_t;
+
+// Forget the driver state and counts, and have the sensor reply in time with 21.0C and 50% RH
+void fake_dht_reset(void);
+
+// Set the outcome of the following measurements
+void fake_dht_set_reply(dht_result_t result, float temperature, float humidity, uint32_t reply_us);
+
+void fake_dht_get_stats(fake_dht_stats_t *stats);
+
+#endif
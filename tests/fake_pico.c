@@ -0,0 +1,201 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "fake_pico.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/pwm.h"
+#include "hardware/watchdog.h"
+#include "lwip/apps/sntp.h"
+#include "pico/cyw43_arch.h"
+#include "pico/multicore.h"
+#include "pico/rand.h"
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+
+#define FAKE __attribute__((weak))
+
+uint64_t fake_now_us;
+
+/* Pending alarms and at-time workers, in one table so they fire in time order */
+#define FAKE_TIMERS 32
+
+typedef struct {
+    bool used;
+    uint64_t at_us;
+    alarm_id_t id;
+    alarm_callback_t cb;                // alarms
+    void *user_data;
+    async_at_time_worker_t *worker;     // or workers
+} fake_timer_t;
+
+static fake_timer_t timers[FAKE_TIMERS];
+static alarm_id_t next_alarm_id = 1;
+
+static fake_timer_t *new_timer(uint64_t at_us) {
+    for (int i = 0; i < FAKE_TIMERS; ++i) {
+        if (!timers[i].used) {
+            timers[i] = (fake_timer_t){.used = true, .at_us = at_us};
+            return &timers[i];
+        }
+    }
+    fprintf(stderr, "fake_pico: out of timers\n");
+    abort();
+}
+
+void fake_time_reset(void) {
+    for (int i = 0; i < FAKE_TIMERS; ++i) timers[i].used = false;
+    fake_now_us = 0;
+}
+
+void fake_run_until(uint64_t t_us) {
+    while (true) {
+        fake_timer_t *first = NULL;
+        for (int i = 0; i < FAKE_TIMERS; ++i) {
+            if (timers[i].used && (timers[i].at_us <= t_us) && ((first == NULL) || (timers[i].at_us < first->at_us))) {
+                first = &timers[i];
+            }
+        }
+        if (first == NULL) break;
+        if (first->at_us > fake_now_us) fake_now_us = first->at_us;
+        fake_timer_t t = *first;
+        first->used = false;
+        if (t.worker != NULL) {
+            t.worker->do_work(NULL, t.worker);
+        } else {
+            int64_t again_us = t.cb(t.id, t.user_data);
+            if (again_us != 0) {
+                fake_timer_t *n = new_timer(fake_now_us + ((again_us < 0) ? -again_us : again_us));
+                n->id = t.id;
+                n->cb = t.cb;
+                n->user_data = t.user_data;
+            }
+        }
+    }
+    if (t_us > fake_now_us) fake_now_us = t_us;
+}
+
+void fake_run_for_ms(uint32_t ms) {
+    fake_run_until(fake_now_us + (uint64_t)ms * 1000);
+}
+
+bool fake_worker_pending(const async_at_time_worker_t *worker) {
+    for (int i = 0; i < FAKE_TIMERS; ++i) {
+        if (timers[i].used && (timers[i].worker == worker)) return true;
+    }
+    return false;
+}
+
+int fake_alarms_pending(void) {
+    int n = 0;
+    for (int i = 0; i < FAKE_TIMERS; ++i) n += timers[i].used && (timers[i].worker == NULL);
+    return n;
+}
+
+/* pico/time.h */
+
+FAKE uint64_t time_us_64(void) { return fake_now_us; }
+FAKE uint32_t time_us_32(void) { return (uint32_t)fake_now_us; }
+FAKE absolute_time_t get_absolute_time(void) { return fake_now_us; }
+FAKE absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+FAKE uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+FAKE absolute_time_t make_timeout_time_ms(uint32_t ms) { return fake_now_us + (uint64_t)ms * 1000; }
+FAKE int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+FAKE void sleep_until(absolute_time_t t) { fake_run_until(t); }
+FAKE void busy_wait_ms(uint32_t ms) { fake_now_us += (uint64_t)ms * 1000; }
+
+FAKE alarm_id_t add_alarm_at(absolute_time_t t, alarm_callback_t cb, void *user_data, bool fire_if_past) {
+    if ((t <= fake_now_us) && !fire_if_past) return 0;
+    fake_timer_t *timer = new_timer(t);
+    timer->id = next_alarm_id++;
+    timer->cb = cb;
+    timer->user_data = user_data;
+    return timer->id;
+}
+
+FAKE alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t cb, void *user_data, bool fire_if_past) {
+    return add_alarm_at(fake_now_us + (uint64_t)ms * 1000, cb, user_data, fire_if_past);
+}
+
+FAKE bool cancel_alarm(alarm_id_t id) {
+    for (int i = 0; i < FAKE_TIMERS; ++i) {
+        if (timers[i].used && (timers[i].worker == NULL) && (timers[i].id == id)) {
+            timers[i].used = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* pico/async_context.h - workers run from fake_run_until() */
+
+FAKE bool async_context_add_at_time_worker_at(async_context_t *context, async_at_time_worker_t *worker, absolute_time_t at) {
+    (void)context;
+    async_context_remove_at_time_worker(context, worker);
+    new_timer(at)->worker = worker;
+    return true;
+}
+
+FAKE bool async_context_add_at_time_worker_in_ms(async_context_t *context, async_at_time_worker_t *worker, uint32_t ms) {
+    return async_context_add_at_time_worker_at(context, worker, fake_now_us + (uint64_t)ms * 1000);
+}
+
+FAKE bool async_context_remove_at_time_worker(async_context_t *context, async_at_time_worker_t *worker) {
+    (void)context;
+    for (int i = 0; i < FAKE_TIMERS; ++i) {
+        if (timers[i].used && (timers[i].worker == worker)) {
+            timers[i].used = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+FAKE async_context_t *cyw43_arch_async_context(void) { return NULL; }
+FAKE void cyw43_arch_lwip_begin(void) {}
+FAKE void cyw43_arch_lwip_end(void) {}
+
+/* pico/sync.h, hardware/sync.h - the tests are single threaded */
+
+FAKE void mutex_init(mutex_t *mtx) { mtx->owner = 0; }
+FAKE void mutex_enter_blocking(mutex_t *mtx) { mtx->owner = 1; }
+FAKE void mutex_exit(mutex_t *mtx) { mtx->owner = 0; }
+FAKE void __sev(void) {}
+FAKE void __wfe(void) {}
+FAKE void __wfi(void) {}
+FAKE void __dmb(void) {}
+FAKE uint32_t save_and_disable_interrupts(void) { return 0; }
+FAKE void restore_interrupts(uint32_t status) { (void)status; }
+
+/* Everything else does nothing */
+
+FAKE void stdio_init_all(void) {}
+FAKE uint32_t get_rand_32(void) { return (uint32_t)rand(); }
+FAKE void multicore_launch_core1(void (*entry)(void)) { (void)entry; }
+FAKE void gpio_init(uint gpio) { (void)gpio; }
+FAKE void gpio_set_dir(uint gpio, bool out) { (void)gpio; (void)out; }
+FAKE void gpio_put(uint gpio, bool value) { (void)gpio; (void)value; }
+FAKE void gpio_set_function(uint gpio, enum gpio_function fn) { (void)gpio; (void)fn; }
+FAKE void irq_set_exclusive_handler(uint num, irq_handler_t handler) { (void)num; (void)handler; }
+FAKE void irq_set_enabled(uint num, bool enabled) { (void)num; (void)enabled; }
+FAKE uint pwm_gpio_to_slice_num(uint gpio) { return gpio / 2; }
+FAKE void pwm_set_clkdiv(uint slice, float divider) { (void)slice; (void)divider; }
+FAKE void pwm_set_wrap(uint slice, uint16_t wrap) { (void)slice; (void)wrap; }
+FAKE void pwm_set_gpio_level(uint gpio, uint16_t level) { (void)gpio; (void)level; }
+FAKE void pwm_set_enabled(uint slice, bool enabled) { (void)slice; (void)enabled; }
+FAKE bool watchdog_caused_reboot(void) { return false; }
+FAKE void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) { (void)delay_ms; (void)pause_on_debug; }
+FAKE void watchdog_update(void) {}
+FAKE void sntp_setoperatingmode(uint8_t operating_mode) { (void)operating_mode; }
+FAKE void sntp_setservername(uint8_t idx, const char *server) { (void)idx; (void)server; }
+FAKE void sntp_init(void) {}
+
+pio_hw_t fake_pio0_hw, fake_pio1_hw;
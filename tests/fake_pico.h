@@ -0,0 +1,31 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef FAKE_PICO_H
+#define FAKE_PICO_H
+
+/* Host fakes for the parts of the Pico SDK the firmware uses (see stubs/).
+   Time only moves when a test moves it, and alarms and async context at-time workers
+   fire, in due order, as it does.  Everything is weak so a test can replace any of it. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/async_context.h"
+#include "pico/time.h"
+
+extern uint64_t fake_now_us;
+
+// Move time forward to t_us, firing every alarm and worker that falls due on the way
+void fake_run_until(uint64_t t_us);
+void fake_run_for_ms(uint32_t ms);
+
+// Forget all pending alarms and workers, and restart time from zero
+void fake_time_reset(void);
+
+bool fake_worker_pending(const async_at_time_worker_t *worker);
+int fake_alarms_pending(void);
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include "ref_glyphs.h"
+
+// Defined in graphics.c, which includes font_3x5.h and font_5x7.h
+extern const uint8_t font_3x5[128][3];
+extern const uint8_t font_5x7[128][5];
+
+static void ref_3x5_char (image_t img, unsigned char c, colour_t fg, colour_t bg, uint16_t x, uint16_t y) {
+    if ((x < (LCD_WIDTH - 3)) && (y < (LCD_HEIGHT - 4))) { // Don't draw outside bounds
+        for (int col = 0; col < 3; ++col) {
+            for (int row = 4; row >= 0; --row) {
+                image_set(img, x + col, y + row, ((font_3x5[c][col] & (2 << row)) != 0) ? fg : bg);
+            }
+        }
+    }
+}
+
+static void ref_5x7_char (image_t img, unsigned char c, colour_t fg, colour_t bg, uint16_t x, uint16_t y) {
+    if ((x < (LCD_WIDTH - 5)) && (y < (LCD_HEIGHT - 7))) { // Don't draw outside bounds
+        for (int col = 0; col < 5; ++col) {
+            for (int row = 6; row >= 0; --row) {
+                image_set(img, x + col, y + row, ((font_5x7[c][col] & (1 << row)) != 0) ? fg : bg);
+            }
+        }
+    }
+}
+
+static void ref_6x10_char (image_t img, unsigned char c, colour_t fg, colour_t bg, uint16_t x, uint16_t y) {
+    if ((x < (LCD_WIDTH - 6)) && (y < (LCD_HEIGHT - 10))) { // Don't draw outside bounds
+        for (int col = 0; col < 3; ++col) {
+            for (int row = 4; row >= 0; --row) {
+                colour_t p = ((font_3x5[c][col] & (2 << row)) != 0) ? fg : bg;
+                image_set(img, x + (col * 2), y + (row * 2), p);
+                image_set(img, x + (col * 2), y + (row * 2) + 1, p);
+                image_set(img, x + 1 + (col * 2), y + (row * 2), p);
+                image_set(img, x + 1 + (col * 2), y + (row * 2) + 1, p);
+            }
+        }
+    }
+}
+
+static void ref_10x14_char (image_t img, unsigned char c, colour_t fg, colour_t bg, uint16_t x, uint16_t y) {
+    if ((x < (LCD_WIDTH - 10)) && (y < (LCD_HEIGHT - 14))) { // Don't draw outside bounds
+        for (int col = 0; col < 5; ++col) {
+            for (int row = 6; row >= 0; --row) {
+                colour_t p = ((font_5x7[c][col] & (1 << row)) != 0) ? fg : bg;
+                image_set(img, x + (col * 2), y + (row * 2), p);
+                image_set(img, x + (col * 2), y + (row * 2) + 1, p);
+                image_set(img, x + 1 + (col * 2), y + (row * 2), p);
+                image_set(img, x + 1 + (col * 2), y + (row * 2) + 1, p);
+            }
+        }
+    }
+}
+
+static void ref_40x56_char (image_t img, unsigned char c, colour_t fg, uint16_t x, uint16_t y) {
+    if ((x < (LCD_WIDTH - 40)) && (y < (LCD_HEIGHT - 56))) { // Don't draw outside bounds
+        for (int font_row = 0; font_row < 7; font_row++) {
+            for (int font_col = 0; font_col < 5; font_col++) {
+                if ((font_5x7[c][font_col] & (1 << font_row)) != 0) {
+                    show_block(img, x + (font_col * 8), y + (font_row * 8), 8, 8, fg);
+                }
+            }
+        }
+    }
+}
+
+/* ref_string is the old show_*_string: clear the background, then draw each character */
+void ref_string (image_t img, const char *msg, uint16_t x, uint16_t y, colour_t fg, colour_t bg,
+                 font_t font, int scale) {
+    int pitch, h;
+    text_style_t st = text_style(font, scale);
+    text_extent(&st, 1, &pitch, &h);
+    int len = strlen(msg);
+    graphics_lock();
+    show_block(img, x, y, len * pitch, h, bg);
+    mark_dirty(x, y, len * pitch, h);
+    for (int ix = 0; ix < len; ++ix) {
+        unsigned char c = msg[ix];
+        uint16_t cx = x + (ix * pitch);
+        if (font == FONT_3X5) {
+            if (scale == 1) ref_3x5_char(img, c, fg, bg, cx, y);
+            else ref_6x10_char(img, c, fg, bg, cx, y);
+        } else if (scale == 1) {
+            ref_5x7_char(img, c, fg, bg, cx, y);
+        } else if (scale == 2) {
+            ref_10x14_char(img, c, fg, bg, cx, y);
+        } else {
+            ref_40x56_char(img, c, fg, cx, y);
+        }
+    }
+    graphics_unlock();
+}
@@ -0,0 +1,20 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef REF_GLYPHS_H
+#define REF_GLYPHS_H
+
+/* The per-pixel glyph and string routines graphics.c had before text_rows() replaced them, kept
+   as the reference the new code is compared and timed against.  Only the names differ (and the
+   hand-unrolled 6x10 and 10x14 loops are rolled up) - bounds checks, write order and locking are
+   as they were.  Like graphics.c they are built on their own, so neither side is specialised for
+   the caller.  Framebuffer builds only. */
+
+#include "graphics.h"
+
+void ref_string (image_t img, const char *msg, uint16_t x, uint16_t y, colour_t fg, colour_t bg,
+                 font_t font, int scale);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _HARDWARE_GPIO_H
+#define _HARDWARE_GPIO_H
+
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+enum { GPIO_IN = 0, GPIO_OUT = 1 };
+enum gpio_function { GPIO_FUNC_PWM = 4 };
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _HARDWARE_IRQ_H
+#define _HARDWARE_IRQ_H
+
+#include <stdbool.h>
+
+typedef unsigned int uint;
+typedef void (*irq_handler_t)(void);
+
+#define DMA_IRQ_1 12
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif
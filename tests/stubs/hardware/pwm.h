@@ -0,0 +1,15 @@
+#ifndef _HARDWARE_PWM_H
+#define _HARDWARE_PWM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+uint pwm_gpio_to_slice_num(uint gpio);
+void pwm_set_clkdiv(uint slice, float divider);
+void pwm_set_wrap(uint slice, uint16_t wrap);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_set_enabled(uint slice, bool enabled);
+
+#endif
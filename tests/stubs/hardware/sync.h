@@ -0,0 +1,13 @@
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+void __sev(void);
+void __wfe(void);
+void __wfi(void);
+void __dmb(void);
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef _LCD_RGB_PIO_H
+#define _LCD_RGB_PIO_H
+
+// Stands in for the header pico_generate_pio_header() makes from src/lcd_rgb.pio
+
+#include "hardware/pio.h"
+
+extern const pio_program_t lcd_rgb_program;
+pio_sm_config lcd_rgb_program_get_default_config(uint offset);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef LWIP_HDR_APPS_SNTP_H
+#define LWIP_HDR_APPS_SNTP_H
+
+#include <stdint.h>
+
+#define SNTP_OPMODE_POLL 0
+
+void sntp_setoperatingmode(uint8_t operating_mode);
+void sntp_setservername(uint8_t idx, const char *server);
+void sntp_init(void);
+
+#endif
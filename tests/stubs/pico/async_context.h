@@ -0,0 +1,22 @@
+#ifndef _PICO_ASYNC_CONTEXT_H
+#define _PICO_ASYNC_CONTEXT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/time.h"
+
+typedef struct async_context async_context_t;
+
+typedef struct async_at_time_worker {
+    struct async_at_time_worker *next;
+    void (*do_work)(async_context_t *context, struct async_at_time_worker *worker);
+    absolute_time_t next_time;
+    void *user_data;
+} async_at_time_worker_t;
+
+bool async_context_add_at_time_worker_at(async_context_t *context, async_at_time_worker_t *worker, absolute_time_t at);
+bool async_context_add_at_time_worker_in_ms(async_context_t *context, async_at_time_worker_t *worker, uint32_t ms);
+bool async_context_remove_at_time_worker(async_context_t *context, async_at_time_worker_t *worker);
+
+#endif
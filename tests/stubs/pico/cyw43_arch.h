@@ -0,0 +1,11 @@
+#ifndef _PICO_CYW43_ARCH_H
+#define _PICO_CYW43_ARCH_H
+
+#include "lwip/apps/mqtt.h"
+#include "pico/async_context.h"
+
+async_context_t *cyw43_arch_async_context(void);
+void cyw43_arch_lwip_begin(void);
+void cyw43_arch_lwip_end(void);
+
+#endif
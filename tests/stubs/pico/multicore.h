@@ -0,0 +1,6 @@
+#ifndef _PICO_MULTICORE_H
+#define _PICO_MULTICORE_H
+
+void multicore_launch_core1(void (*entry)(void));
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _PICO_RAND_H
+#define _PICO_RAND_H
+
+#include <stdint.h>
+
+uint32_t get_rand_32(void);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+#include <stdio.h>
+
+#include "hardware/gpio.h"
+#include "pico/sync.h"
+#include "pico/time.h"
+
+void stdio_init_all(void);
+
+#endif
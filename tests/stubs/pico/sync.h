@@ -0,0 +1,20 @@
+#ifndef _PICO_SYNC_H
+#define _PICO_SYNC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hardware/sync.h"
+
+typedef unsigned int uint;
+
+typedef struct { int owner; } mutex_t;
+
+void mutex_init(mutex_t *mtx);
+void mutex_enter_blocking(mutex_t *mtx);
+void mutex_exit(mutex_t *mtx);
+
+#define tight_loop_contents() do {} while (0)
+
+#endif
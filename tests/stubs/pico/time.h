@@ -0,0 +1,25 @@
+#ifndef _PICO_TIME_H
+#define _PICO_TIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+absolute_time_t get_absolute_time(void);
+absolute_time_t from_us_since_boot(uint64_t us);
+uint64_t to_us_since_boot(absolute_time_t t);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+void sleep_until(absolute_time_t t);
+void busy_wait_ms(uint32_t ms);
+
+alarm_id_t add_alarm_at(absolute_time_t t, alarm_callback_t cb, void *user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t cb, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t id);
+
+#endif
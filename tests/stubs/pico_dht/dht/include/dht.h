@@ -0,0 +1,31 @@
+#ifndef _DHT_H
+#define _DHT_H
+
+// The parts of pico_dht's interface the firmware uses
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/pio.h"
+
+typedef enum { DHT11, DHT12, DHT21, DHT22 } dht_model_t;
+
+typedef enum { DHT_RESULT_OK, DHT_RESULT_TIMEOUT, DHT_RESULT_BAD_CHECKSUM } dht_result_t;
+
+typedef struct {
+    PIO pio;
+    uint8_t model;
+    uint8_t pio_program_offset;
+    uint8_t sm;
+    uint8_t dma_chan;
+    uint8_t data_pin;
+    uint8_t data[5];
+    uint32_t start_time;
+} dht_t;
+
+void dht_init(dht_t *dht, dht_model_t model, PIO pio, uint8_t data_pin, bool pull_up);
+void dht_deinit(dht_t *dht);
+void dht_start_measurement(dht_t *dht);
+dht_result_t dht_finish_measurement_blocking(dht_t *dht, float *humidity, float *temperature_c);
+
+#endif
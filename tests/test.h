@@ -0,0 +1,39 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+/* Just enough of a test framework: each test_* function CHECKs what it expects, and main()
+   RUNs them and returns test_result() for ctest. */
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++test_failures; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) do { \
+        long long a_ = (long long)(a), b_ = (long long)(b); \
+        if (a_ != b_) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, a_, b_); \
+            ++test_failures; \
+        } \
+    } while (0)
+
+#define RUN(test) do { printf("-- %s\n", #test); test(); } while (0)
+
+static inline int test_result(void) {
+    if (test_failures > 0) printf("%d check(s) failed\n", test_failures);
+    else printf("All passed\n");
+    return test_failures > 0;
+}
+
+#endif
@@ -0,0 +1,212 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * sntp_clock.c against a simulated timer: the clock items it draws across day, month and year
+ * rollovers and the EU summer time changes, when it draws them, and how it corrects for a crystal
+ * running fast or slow.  It is included here so that its state can be reset between tests.
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "fake_pico.h"
+#include "test.h"
+
+#include "../src/sntp_clock.c"
+
+const info_item_t info_items[] = {
+    INFO_ITEM(CLOCK_HHMMSS, "", "", "", 0, 0, YELLOW, BLACK, FONT_5X7, 1, 8),
+    INFO_ITEM(CLOCK_DATE, "", "", "", 0, 10, MAGENTA, BLACK, FONT_5X7, 1, 10),
+    INFO_ITEM(CLOCK_HHMM, "", "", "", 0, 20, YELLOW, BLACK, FONT_5X7, 1, 5),
+};
+const int INFO_ITEM_COUNT = sizeof(info_items) / sizeof(info_items[0]);
+
+enum { HHMMSS, DATE, HHMM };
+
+/* show_data records the text each item was given, and when */
+static char shown[3][CLOCK_TEXT_MAX];
+static uint64_t shown_at_us;
+static int renders;
+
+void show_data(int id, const char *data, int len) {
+    memcpy(shown[id], data, len);
+    shown[id][len] = '\0';
+    shown_at_us = fake_now_us;
+}
+
+void info_render_now() { ++renders; }
+
+static void reset_clock() {
+    fake_time_reset();
+    fake_now_us = 5000000;      // booted a while ago
+    synced = false;
+    ticking = false;
+    memset(&stats, 0, sizeof(stats));
+    memset(item_text, 0, sizeof(item_text));
+    memset(shown, 0, sizeof(shown));
+    renders = 0;
+}
+
+/* utc gives the seconds since 1970 of a UTC date and time, independently of sntp_clock.c */
+static time_t utc(int year, int month, int day, int hour, int min, int sec) {
+    struct tm tm = {.tm_year = year - 1900, .tm_mon = month - 1, .tm_mday = day,
+                    .tm_hour = hour, .tm_min = min, .tm_sec = sec};
+    return timegm(&tm);
+}
+
+/* sync_to sets the clock to a UTC time plus us, and lets its first tick run */
+static void sync_to(time_t t, uint32_t us) {
+    clock_sntp_set(t, us);
+    fake_run_for_ms(1000);
+}
+
+/* next_second runs until the clock's next tick, and checks it came on the second boundary */
+static void next_second() {
+    uint64_t before = shown_at_us;
+    int ticks = stats.ticks;
+    fake_run_for_ms(1000);
+    CHECK_EQ(stats.ticks, ticks + 1);
+    CHECK(shown_at_us != before);
+    CHECK_EQ(utc_us_at(shown_at_us) % 1000000, 0);
+}
+
+static void check_shown(const char *hhmmss, const char *date) {
+    if ((strcmp(shown[HHMMSS], hhmmss) != 0) || (strcmp(shown[DATE], date) != 0)) {
+        fprintf(stderr, "shown \"%s\" \"%s\", expected \"%s\" \"%s\"\n", shown[HHMMSS], shown[DATE], hhmmss, date);
+        CHECK(false);
+    }
+    CHECK(strncmp(shown[HHMM], hhmmss, 5) == 0);
+}
+
+static void test_first_tick() {
+    reset_clock();
+    clock_setup();
+    CHECK(have_items);
+    clock_sntp_set(utc(2024, 6, 14, 10, 20, 30), 250000);
+    CHECK_EQ(renders, 0);
+    fake_run_for_ms(749);
+    CHECK_EQ(renders, 0);
+    fake_run_for_ms(1);         // the start of the next second, not a second after the sync
+    CHECK_EQ(renders, 1);
+    check_shown("12:20:31", "Fri 14 Jun");      // CEST
+    next_second();
+    check_shown("12:20:32", "Fri 14 Jun");
+}
+
+static void test_rollovers() {
+    struct {
+        time_t at;                  // two seconds before local midnight
+        const char *before, *after;
+    } cases[] = {
+        {utc(2024, 6, 14, 21, 59, 58), "Fri 14 Jun", "Sat 15 Jun"},     // day
+        {utc(2024, 4, 30, 21, 59, 58), "Tue 30 Apr", "Wed 01 May"},     // 30-day month
+        {utc(2024, 2, 28, 22, 59, 58), "Wed 28 Feb", "Thu 29 Feb"},     // leap year
+        {utc(2024, 2, 29, 22, 59, 58), "Thu 29 Feb", "Fri 01 Mar"},
+        {utc(2023, 2, 28, 22, 59, 58), "Tue 28 Feb", "Wed 01 Mar"},
+        {utc(2023, 12, 31, 22, 59, 58), "Sun 31 Dec", "Mon 01 Jan"},    // year
+    };
+    for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        reset_clock();
+        sync_to(cases[i].at, 0);
+        check_shown("23:59:59", cases[i].before);
+        next_second();
+        check_shown("00:00:00", cases[i].after);
+        next_second();
+        check_shown("00:00:01", cases[i].after);
+    }
+}
+
+/* Summer time starts at 01:00 UTC on the last Sunday in March, and ends at 01:00 UTC on the last
+   Sunday in October */
+static void test_dst() {
+    struct {
+        int year, march, october;
+    } sundays[] = {{2023, 26, 29}, {2024, 31, 27}, {2025, 30, 26}, {2026, 29, 25}};
+    for (unsigned int i = 0; i < sizeof(sundays) / sizeof(sundays[0]); ++i) {
+        int y = sundays[i].year;
+        char date[CLOCK_TEXT_MAX];
+
+        reset_clock();
+        sync_to(utc(y, 3, sundays[i].march, 0, 59, 58), 0);
+        snprintf(date, sizeof(date), "Sun %02d Mar", sundays[i].march);
+        check_shown("01:59:59", date);
+        next_second();
+        check_shown("03:00:00", date);
+
+        reset_clock();
+        sync_to(utc(y, 10, sundays[i].october, 0, 59, 58), 0);
+        snprintf(date, sizeof(date), "Sun %02d Oct", sundays[i].october);
+        check_shown("02:59:59", date);
+        next_second();
+        check_shown("02:00:00", date);
+
+        // a week either side is not affected
+        CHECK_EQ(local_seconds(utc(y, 3, sundays[i].march - 7, 12, 0, 0)), utc(y, 3, sundays[i].march - 7, 13, 0, 0));
+        CHECK_EQ(local_seconds(utc(y, 4, 7, 12, 0, 0)), utc(y, 4, 7, 14, 0, 0));
+        CHECK_EQ(local_seconds(utc(y, 10, sundays[i].october - 7, 12, 0, 0)), utc(y, 10, sundays[i].october - 7, 14, 0, 0));
+        CHECK_EQ(local_seconds(utc(y, 11, 1, 12, 0, 0)), utc(y, 11, 1, 13, 0, 0));
+    }
+}
+
+/* run_crystal moves the timer on by true_us of real time, for a crystal ppm fast (or slow) */
+static void run_crystal(int ppm, uint64_t true_us) {
+    fake_run_until(fake_now_us + true_us + (int64_t)true_us * ppm / 1000000);
+}
+
+/* Each update at least RATE_MIN_INTERVAL_US after the last corrects the rate by half the error
+   seen, so the estimate closes in on the crystal's error: -50, -75, -87... for 100 ppm fast */
+static void test_drift_correction() {
+    reset_clock();
+    const int crystal_ppm = 100;
+    const uint64_t interval_us = 20 * 60 * 1000000ull;
+    time_t t = utc(2024, 6, 14, 12, 0, 0);
+    clock_sntp_set(t, 0);
+    int32_t expect = 0;
+    for (int i = 0; i < 6; ++i) {
+        run_crystal(crystal_ppm, interval_us);
+        t += interval_us / 1000000;
+        clock_sntp_set(t, 0);
+        expect += (-crystal_ppm - expect) / 2;
+        CHECK(labs(stats.rate_ppm - expect) <= 1);
+    }
+    CHECK(labs(stats.rate_ppm + crystal_ppm) <= 3);
+    // with the rate corrected, the clock keeps close time between updates
+    // the drift between updates falls with the rate error: 100 ppm of 20 minutes at first, then a
+    // few ppm (the correction is truncated to whole ppm)
+    CHECK_EQ(stats.max_error_us, 120000);
+    CHECK(labs(stats.last_error_us) < stats.max_error_us / 16);
+
+    // updates closer together than RATE_MIN_INTERVAL_US do not change the rate
+    int32_t rate = stats.rate_ppm;
+    run_crystal(crystal_ppm, 60 * 1000000ull);
+    clock_sntp_set(t + 60, 0);
+    CHECK_EQ(stats.rate_ppm, rate);
+    CHECK_EQ(stats.syncs, 8);
+}
+
+/* A crystal error beyond CLOCK_MAX_PPM is not believed */
+static void test_drift_clamped() {
+    for (int sign = -1; sign <= 1; sign += 2) {
+        reset_clock();
+        time_t t = utc(2024, 6, 14, 12, 0, 0);
+        clock_sntp_set(t, 0);
+        for (int i = 0; i < 3; ++i) {
+            run_crystal(sign * 3000, 2 * RATE_MIN_INTERVAL_US);
+            t += 2 * RATE_MIN_INTERVAL_US / 1000000;
+            clock_sntp_set(t, 0);
+            CHECK_EQ(stats.rate_ppm, -sign * CLOCK_MAX_PPM);
+        }
+    }
+}
+
+int main() {
+    RUN(test_first_tick);
+    RUN(test_rollovers);
+    RUN(test_dst);
+    RUN(test_drift_correction);
+    RUN(test_drift_clamped);
+    return test_result();
+}
@@ -0,0 +1,130 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * show_string() against the per-pixel routines it replaced (ref_glyphs.h): every character, in
+ * every text style, at odd and even x, must leave exactly the same pixels and dirty regions.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fake_pico.h"
+#include "test.h"
+
+#include "ref_glyphs.h"
+
+typedef struct {
+    font_t font;
+    int scale;
+    int width, height;      // of a glyph, without the gap
+} style_t;
+
+static const style_t styles[] = {
+    {FONT_3X5, 1, 3, 5}, {FONT_3X5, 2, 6, 10}, {FONT_5X7, 1, 5, 7}, {FONT_5X7, 2, 10, 14}, {FONT_5X7, 4, 40, 56},
+};
+
+static mutex_t image_mutex;
+static image_t want, got;
+static uint8_t background[LCD_HEIGHT][LCD_WIDTH / 2];
+
+/* compare draws msg both ways over the same background, and checks the images and dirty lists agree */
+static void compare(const char *msg, uint16_t x, uint16_t y, colour_t fg, colour_t bg, const style_t *st) {
+    rect_t want_rects[MAX_DIRTY_RECTS], got_rects[MAX_DIRTY_RECTS];
+    memcpy(want, background, sizeof(image_t));
+    memcpy(got, background, sizeof(image_t));
+    ref_string(want, msg, x, y, fg, bg, st->font, st->scale);
+    int n_want = take_dirty_rects(want_rects);
+    show_string(got, (char *)msg, x, y, fg, bg, st->font, st->scale);
+    int n_got = take_dirty_rects(got_rects);
+
+    CHECK_EQ(n_got, n_want);
+    if ((n_got == n_want) && (memcmp(got_rects, want_rects, n_got * sizeof(rect_t)) != 0)) {
+        fprintf(stderr, "dirty regions differ for \"%s\" font %d scale %d at %d,%d\n", msg, st->font, st->scale, x, y);
+        CHECK(false);
+    }
+    if (memcmp(got, want, sizeof(image_t)) == 0) return;
+    for (int py = 0; py < LCD_HEIGHT; py++) {
+        for (int px = 0; px < LCD_WIDTH; px++) {
+            if (image_get(got, px, py) != image_get(want, px, py)) {
+                fprintf(stderr, "\"%s\" font %d scale %d at %d,%d differs at pixel %d,%d\n",
+                        msg, st->font, st->scale, x, y, px, py);
+                CHECK(false);
+                return;
+            }
+        }
+    }
+}
+
+static void test_every_character() {
+    char msg[2] = {0, 0};
+    for (unsigned int s = 0; s < sizeof(styles) / sizeof(styles[0]); s++) {
+        for (int c = 1; c < 128; c++) {
+            msg[0] = c;
+            for (int x = 100; x < 102; x++) {       // both nibble phases
+                compare(msg, x, 37, WHITE, BLUE, &styles[s]);
+            }
+        }
+    }
+}
+
+static void test_strings() {
+    const char *msgs[] = {"12:34:56", "Sat 17 Oct", "-3.5C", "~!@#$%^&*()_+{}|", "A"};
+    const uint16_t xs[] = {0, 1, 7, 130, 131};
+    const uint16_t ys[] = {0, 1, 120, LCD_HEIGHT - 57};
+    for (unsigned int s = 0; s < sizeof(styles) / sizeof(styles[0]); s++) {
+        for (unsigned int m = 0; m < sizeof(msgs) / sizeof(msgs[0]); m++) {
+            for (unsigned int i = 0; i < sizeof(xs) / sizeof(xs[0]); i++) {
+                for (unsigned int j = 0; j < sizeof(ys) / sizeof(ys[0]); j++) {
+                    compare(msgs[m], xs[i], ys[j], YELLOW, BLACK, &styles[s]);
+                    compare(msgs[m], xs[i], ys[j], BLACK, MAGENTA, &styles[s]);
+                }
+            }
+        }
+    }
+}
+
+/* A character that exactly fits against the right or bottom edge was left out by the old
+   routines, whose bounds checks were off by one.  show_string draws it as it would anywhere else. */
+static void check_edge_glyph(const style_t *st, uint16_t x, uint16_t y, int dx, int dy) {
+    memcpy(want, background, sizeof(image_t));
+    memcpy(got, background, sizeof(image_t));
+    ref_string(want, "8", x - dx, y - dy, GREEN, RED, st->font, st->scale);
+    show_string(got, "8", x, y, GREEN, RED, st->font, st->scale);
+    take_dirty_rects((rect_t[MAX_DIRTY_RECTS]){0});
+    int bad = 0;
+    for (int j = 0; j < st->height; j++) {
+        for (int i = 0; i < st->width; i++) {
+            if (image_get(got, x + i, y + j) != image_get(want, x - dx + i, y - dy + j)) ++bad;
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+static void test_edges() {
+    for (unsigned int s = 0; s < sizeof(styles) / sizeof(styles[0]); s++) {
+        const style_t *st = &styles[s];
+        for (int x = LCD_WIDTH - st->width - 3; x < LCD_WIDTH; x++) {
+            if (x == LCD_WIDTH - st->width) check_edge_glyph(st, x, 100, 2, 0);
+            else compare("8", x, 100, GREEN, RED, st);
+        }
+        for (int y = LCD_HEIGHT - st->height - 3; y < LCD_HEIGHT; y++) {
+            // only the 3x5 check was right at the bottom
+            bool old_fits = (st->font == FONT_3X5) && (st->scale == 1);
+            if ((y == LCD_HEIGHT - st->height) && !old_fits) check_edge_glyph(st, 100, y, 0, 2);
+            else compare("8", 100, y, GREEN, RED, st);
+        }
+    }
+}
+
+int main() {
+    graphics_init(&image_mutex);
+    srand(1);
+    for (unsigned int i = 0; i < sizeof(background); i++) ((uint8_t *)background)[i] = rand();
+    RUN(test_every_character);
+    RUN(test_strings);
+    RUN(test_edges);
+    return test_result();
+}
@@ -0,0 +1,176 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * json_scan() on the payloads info items take their fields from: the members it reports and their
+ * dotted paths, what it skips, and where it gives up - on malformed or cut-off input, and beyond
+ * JSON_PATH_MAX and JSON_MAX_DEPTH.
+*/
+
+#include <string.h>
+
+#include "test.h"
+
+#include "json.h"
+
+/* found records each member reported as "path=value" */
+#define MAX_FOUND 16
+
+static char found_text[MAX_FOUND][JSON_PATH_MAX + 32];
+static int found_count;
+
+static void found(const char *path, int path_len, const char *value, int value_len, void *arg) {
+    (void)arg;
+    if (found_count < MAX_FOUND) {
+        snprintf(found_text[found_count], sizeof(found_text[0]), "%.*s=%.*s", path_len, path, value_len, value);
+    }
+    ++found_count;
+}
+
+static bool scan(const char *json) {
+    found_count = 0;
+    return json_scan(json, strlen(json), found, NULL);
+}
+
+/* check_found checks the members reported, in order */
+static void check_found(const char *const expect[], int n) {
+    CHECK_EQ(found_count, n);
+    for (int i = 0; (i < n) && (i < found_count) && (i < MAX_FOUND); ++i) {
+        if (strcmp(found_text[i], expect[i]) != 0) {
+            fprintf(stderr, "member %d is \"%s\", expected \"%s\"\n", i, found_text[i], expect[i]);
+            CHECK(false);
+        }
+    }
+}
+
+#define CHECK_FOUND(...) do { \
+        const char *const expect_[] = {__VA_ARGS__}; \
+        check_found(expect_, sizeof(expect_) / sizeof(expect_[0])); \
+    } while (0)
+
+static void test_members() {
+    CHECK(scan("{\"temperature\":21.5,\"humidity\":52,\"state\":\"ON\",\"ok\":true,\"x\":null}"));
+    CHECK_FOUND("temperature=21.5", "humidity=52", "state=ON", "ok=true", "x=null");
+    CHECK(scan(" \t\r\n{ \"a\" : -1.5e3 ,\n \"b\" :\"\" } \n"));
+    CHECK_FOUND("a=-1.5e3", "b=");
+    CHECK(scan("{}"));
+    CHECK_EQ(found_count, 0);
+}
+
+static void test_nested_paths() {
+    CHECK(scan("{\"a\":{\"b\":{\"c\":1,\"d\":\"x\"},\"e\":2},\"f\":{},\"g\":3}"));
+    CHECK_FOUND("a.b.c=1", "a.b.d=x", "a.e=2", "g=3");
+    CHECK(scan("{\"update\":{\"state\":\"idle\"},\"update_available\":false}"));
+    CHECK_FOUND("update.state=idle", "update_available=false");
+}
+
+/* Arrays are skipped whole, whatever they hold, and the members after them still reported */
+static void test_arrays_skipped() {
+    CHECK(scan("{\"a\":[1,2,3],\"b\":[{\"c\":4},[5,[6]],\"7\"],\"d\":[],\"e\":8}"));
+    CHECK_FOUND("e=8");
+    CHECK(scan("[{\"a\":1}]"));
+    CHECK_EQ(found_count, 0);
+}
+
+/* Escapes are left as they are, and an escaped quote does not end the string */
+static void test_escapes() {
+    CHECK(scan("{\"msg\":\"say \\\"hi\\\"\",\"path\":\"c:\\\\\",\"q\\\"k\":1}"));
+    CHECK_FOUND("msg=say \\\"hi\\\"", "path=c:\\\\", "q\\\"k=1");
+}
+
+/* A payload that is not an object is reported as a single member with an empty path, so
+   callers must not take it for a field */
+static void test_scalar_payload() {
+    CHECK(scan("21.5"));
+    CHECK_FOUND("=21.5");
+    CHECK(scan("\"text\""));
+    CHECK_FOUND("=text");
+}
+
+/* Malformed and cut-off input fails, but the members before the fault are still reported */
+static void test_malformed() {
+    const char *bad[] = {"", " ", "{", "{\"a\"", "{\"a\":", "{\"a\":1", "{\"a\":1,", "{\"a\":1,}", "{\"a\" 1}",
+                         "{a:1}", "{\"a\":1}}", "{\"a\":1} x", "{\"a\":\"b", "{\"a\":\"b\\\"}", "{\"a\":[1,2}",
+                         "{\"a\":1 \"b\":2}", "{\"a\":}", "{,}"};
+    for (unsigned int i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        if (scan(bad[i])) {
+            fprintf(stderr, "accepted malformed \"%s\"\n", bad[i]);
+            CHECK(false);
+        }
+    }
+    CHECK(!scan("{\"a\":1,\"b\":{\"c\":2,"));
+    CHECK_FOUND("a=1", "b.c=2");
+
+    // only len bytes are read, so a payload cut short fails even with the rest in memory
+    const char *whole = "{\"a\":1,\"b\":2}";
+    found_count = 0;
+    CHECK(!json_scan(whole, strlen(whole) - 1, found, NULL));
+    CHECK_FOUND("a=1", "b=2");
+    found_count = 0;
+    CHECK(!json_scan(whole, 9, found, NULL));
+    CHECK_FOUND("a=1");
+}
+
+/* Paths of JSON_PATH_MAX characters or more are not reported, nor anything below them */
+static void test_path_max() {
+    char json[3 * JSON_PATH_MAX], name[JSON_PATH_MAX + 1];
+    memset(name, 'n', sizeof(name));
+    name[JSON_PATH_MAX - 1] = '\0';     // the longest name that can be reported
+    snprintf(json, sizeof(json), "{\"%s\":1,\"b\":2}", name);
+    CHECK(scan(json));
+    CHECK_EQ(found_count, 2);
+    CHECK_EQ(strlen(found_text[0]), JSON_PATH_MAX - 1 + 2);
+
+    name[JSON_PATH_MAX - 1] = 'n';
+    name[JSON_PATH_MAX] = '\0';
+    snprintf(json, sizeof(json), "{\"%s\":1,\"b\":2}", name);
+    CHECK(scan(json));
+    CHECK_FOUND("b=2");
+
+    // a long path below a short one, and the members after it
+    name[JSON_PATH_MAX - 3] = '\0';
+    snprintf(json, sizeof(json), "{\"ab\":{\"%s\":1,\"c\":{\"d\":2}},\"e\":3}", name);
+    CHECK(scan(json));
+    CHECK_FOUND("ab.c.d=2", "e=3");
+}
+
+/* Objects (or arrays) nested deeper than JSON_MAX_DEPTH are rejected */
+static void test_max_depth() {
+    char json[8 * JSON_MAX_DEPTH + 16];
+    int n = 0;
+    for (int i = 0; i < JSON_MAX_DEPTH; ++i) n += sprintf(&json[n], "{\"a\":");
+    n += sprintf(&json[n], "1");
+    for (int i = 0; i < JSON_MAX_DEPTH; ++i) json[n++] = '}';
+    json[n] = '\0';
+    CHECK(scan(json));
+    CHECK_EQ(found_count, 1);
+
+    n = 0;
+    for (int i = 0; i <= JSON_MAX_DEPTH; ++i) n += sprintf(&json[n], "{\"a\":");
+    n += sprintf(&json[n], "1");
+    for (int i = 0; i <= JSON_MAX_DEPTH; ++i) json[n++] = '}';
+    json[n] = '\0';
+    CHECK(!scan(json));
+    CHECK_EQ(found_count, 0);
+
+    n = sprintf(json, "{\"a\":");
+    for (int i = 0; i < JSON_MAX_DEPTH; ++i) json[n++] = '[';
+    json[n++] = '1';
+    for (int i = 0; i < JSON_MAX_DEPTH; ++i) json[n++] = ']';
+    n += sprintf(&json[n], "}");
+    CHECK(!scan(json));
+}
+
+int main() {
+    RUN(test_members);
+    RUN(test_nested_paths);
+    RUN(test_arrays_skipped);
+    RUN(test_escapes);
+    RUN(test_scalar_payload);
+    RUN(test_malformed);
+    RUN(test_path_max);
+    RUN(test_max_depth);
+    return test_result();
+}
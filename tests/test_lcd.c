@@ -0,0 +1,593 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * lcd.c against a fake PIO and DMA.
+ *
+ * Everything written to the state machines - command bytes from the CPU, pixel bytes or words
+ * from the CPU or DMA - is fed to a model of the panel, which follows DC, CASET, PASET and
+ * Memory Write just as the ILI9488 does.  The fakes also check the ordering rules lcd.c relies on:
+ * no DMA transfer is started while its channel is busy, no buffer changes while DMA is reading it,
+ * and no command byte or DC change overtakes pixel data still being sent.
+ *
+ * Packed lcd_rgb words are turned into wire bytes by a cycle-level model of the lcd_rgb PIO
+ * program, which is itself checked against the same model running the byte-wide lcd program.
+ *
+ * Built once for each combination of LCD_USE_DMA and LCD_USE_PIO_RGB (see CMakeLists.txt).
+*/
+
+#include <string.h>
+
+#include "fake_pico.h"
+#include "test.h"
+
+#include "lcd.c"    // the source under test, so its static functions can be called
+
+/* The panel model */
+
+#define PANEL_WRITES 64
+
+typedef struct {
+    uint16_t x0, x1, y0, y1;    // window set by CASET and PASET
+    uint32_t bytes;             // pixel bytes that followed Memory Write
+    int transfers;              // DMA transfers that carried them
+} panel_write_t;
+
+static uint8_t panel[LCD_HEIGHT][LCD_WIDTH][3];
+static bool panel_dc;
+static uint8_t panel_cmd;
+static uint8_t panel_args[4];
+static int panel_nargs;
+static uint16_t win_x0, win_x1, win_y0, win_y1;
+static int wr_x, wr_y, wr_byte;
+static panel_write_t writes[PANEL_WRITES];
+static int n_writes;
+
+static void panel_byte(uint8_t b) {
+    if (!panel_dc) {
+        panel_cmd = b;
+        panel_nargs = 0;
+        if ((b == CMD_MEMORY_WRITE) && (n_writes < PANEL_WRITES)) {
+            writes[n_writes++] = (panel_write_t){win_x0, win_x1, win_y0, win_y1, 0, 0};
+            wr_x = win_x0;
+            wr_y = win_y0;
+            wr_byte = 0;
+        }
+        return;
+    }
+    switch (panel_cmd) {
+    case CMD_COLUMN_ADDRESS_SET:
+    case CMD_PAGE_ADDRESS_SET:
+        if (panel_nargs < 4) panel_args[panel_nargs++] = b;
+        if (panel_nargs == 4) {
+            uint16_t start = (panel_args[0] << 8) | panel_args[1];
+            uint16_t end = (panel_args[2] << 8) | panel_args[3];
+            if (panel_cmd == CMD_COLUMN_ADDRESS_SET) { win_x0 = start; win_x1 = end; }
+            else { win_y0 = start; win_y1 = end; }
+        }
+        break;
+    case CMD_MEMORY_WRITE:
+        writes[n_writes - 1].bytes++;
+        CHECK(wr_y <= win_y1);      // no more data than the window holds
+        if ((wr_y < LCD_HEIGHT) && (wr_x < LCD_WIDTH)) panel[wr_y][wr_x][wr_byte] = b;
+        if (++wr_byte == 3) {
+            wr_byte = 0;
+            if (++wr_x > win_x1) {
+                wr_x = win_x0;
+                ++wr_y;
+            }
+        }
+        break;
+    }
+}
+
+/* A model of the PIO running the programs in lcd.pio and lcd_rgb.pio (transcribed below - keep
+   them in step), one instruction per cycle.  Autopull shifts left, as both programs are set up to. */
+
+typedef enum { OP_OUT_PINS, OP_SET_X, OP_SET_PINS, OP_JMP_X_DEC, OP_NOP } pio_op_t;
+
+typedef struct {
+    pio_op_t op;
+    uint8_t arg;        // SET value or JMP target
+    uint8_t side;       // side-set value, i.e. CLK
+} pio_instr_t;
+
+static const pio_instr_t lcd_model[] = {
+    {OP_OUT_PINS, 0, 0},    // out pins, 1   side 0
+    {OP_NOP, 0, 1},         // nop           side 1
+};
+
+static const pio_instr_t lcd_rgb_model[] = {
+    {OP_OUT_PINS, 0, 0},    // out pins, 1   side 0
+    {OP_SET_X, 6, 1},       // set x, 6      side 1
+    {OP_SET_PINS, 0, 0},    // zeros: set pins, 0  side 0
+    {OP_JMP_X_DEC, 2, 1},   // jmp x-- zeros side 1
+};
+
+#define MODEL_MAX_BITS (PIO_RGB_PIXELS_PER_WORD * 3 * 8 * 4)
+
+typedef struct {
+    uint8_t bits[MODEL_MAX_BITS];   // MOSI as sampled on each rising CLK edge
+    int n_bits;
+    int cycles;
+} pio_trace_t;
+
+/* pio_model_run runs a program until it stalls on an empty FIFO, pulling threshold bits at a time */
+static void pio_model_run(const pio_instr_t *prog, int len, int threshold, const uint32_t *fifo, int n_words,
+                          pio_trace_t *t) {
+    uint32_t osr = 0, x = 0;
+    int osr_bits = 0, pc = 0;
+    bool mosi = false, clk = true;
+    t->n_bits = t->cycles = 0;
+    while (true) {
+        const pio_instr_t *in = &prog[pc];
+        int next = (pc + 1) % len;
+        if (in->op == OP_OUT_PINS) {
+            if (osr_bits == 0) {
+                if (n_words == 0) return;   // stalled - the FIFO is empty
+                osr = *fifo++;
+                --n_words;
+                osr_bits = threshold;
+            }
+            mosi = osr >> 31;
+            osr <<= 1;
+            --osr_bits;
+        } else if (in->op == OP_SET_X) {
+            x = in->arg;
+        } else if (in->op == OP_SET_PINS) {
+            mosi = in->arg & 1;
+        } else if (in->op == OP_JMP_X_DEC) {
+            if (x-- != 0) next = in->arg;
+        }
+        if (in->side && !clk) {
+            CHECK(t->n_bits < MODEL_MAX_BITS);
+            if (t->n_bits < MODEL_MAX_BITS) t->bits[t->n_bits++] = mosi;
+        }
+        clk = in->side;
+        ++t->cycles;
+        pc = next;
+    }
+}
+
+static int trace_bytes(const pio_trace_t *t, uint8_t *bytes) {
+    for (int i = 0; i < t->n_bits / 8; i++) {
+        bytes[i] = 0;
+        for (int b = 0; b < 8; b++) bytes[i] = (bytes[i] << 1) | t->bits[i * 8 + b];
+    }
+    return t->n_bits / 8;
+}
+
+/* A packed lcd_rgb word is expanded to its 24 wire bytes by the model of the lcd_rgb program */
+static void panel_rgb_word(uint32_t word) {
+    pio_trace_t t;
+    uint8_t bytes[MODEL_MAX_BITS / 8];
+    pio_model_run(lcd_rgb_model, 4, PIO_RGB_PIXELS_PER_WORD * 3, &word, 1, &t);
+    int n = trace_bytes(&t, bytes);
+    CHECK_EQ(n, PIO_RGB_PIXELS_PER_WORD * 3);
+    for (int i = 0; i < n; i++) panel_byte(bytes[i]);
+}
+
+/* The fake PIO.  lcd_pio_put() stores straight into the TX FIFO register, which the fake cannot
+   see happen, but it always asks pio_sm_is_tx_fifo_full() first - so each such call means a byte
+   follows, and it is collected from the register at the next call into the fakes. */
+
+static bool sm_enabled[2];
+static int pending_sm = -1;
+static bool dma_busy_any();
+
+static void flush_fifo() {
+    if (pending_sm < 0) return;
+    uint8_t b = LCD_PIO->txf[pending_sm];
+    pending_sm = -1;
+    panel_byte(b);
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm) {
+    flush_fifo();
+    CHECK(pio == LCD_PIO);
+    CHECK(sm == LCD_PIO_SM);
+    CHECK(sm_enabled[sm]);
+    CHECK(!dma_busy_any());     // would overtake pixel data still being sent
+    pending_sm = sm;
+    return false;
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+    flush_fifo();
+    CHECK(pio == LCD_PIO);
+    CHECK(sm_enabled[sm]);
+    if (sm == LCD_PIO_RGB_SM) panel_rgb_word(data);
+    else panel_byte(data >> 24);
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    flush_fifo();
+    CHECK(pio == LCD_PIO);
+    CHECK(!dma_busy_any());
+    sm_enabled[sm] = enabled;
+    CHECK(!(sm_enabled[LCD_PIO_SM] && sm_enabled[LCD_PIO_RGB_SM]));   // they share the pins
+}
+
+void gpio_put(uint gpio, bool value) {
+    flush_fifo();
+    if (gpio != LCD_PIN_DC) return;
+    CHECK(!dma_busy_any());
+    panel_dc = value;
+}
+
+const pio_program_t lcd_program = {NULL, 2, -1};
+const pio_program_t lcd_rgb_program = {NULL, 4, -1};
+pio_sm_config lcd_program_get_default_config(uint offset) { (void)offset; return (pio_sm_config){0}; }
+pio_sm_config lcd_rgb_program_get_default_config(uint offset) { (void)offset; return (pio_sm_config){0}; }
+uint pio_add_program(PIO pio, const pio_program_t *program) { (void)pio; (void)program; return 0; }
+void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) { (void)c; (void)join; }
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {
+    (void)c; (void)shift_right; (void)autopull; (void)pull_threshold;
+}
+void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) { (void)c; (void)out_base; (void)out_count; }
+void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count) { (void)c; (void)set_base; (void)set_count; }
+void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base) { (void)c; (void)sideset_base; }
+void sm_config_set_clkdiv(pio_sm_config *c, float div) { (void)c; (void)div; }
+void pio_gpio_init(PIO pio, uint pin) { (void)pio; (void)pin; }
+int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+    (void)pio; (void)sm; (void)pin_base; (void)pin_count; (void)is_out;
+    return 0;
+}
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    (void)pio; (void)initial_pc; (void)config;
+    sm_enabled[sm] = false;
+    return 0;
+}
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div) { (void)pio; (void)sm; (void)div; }
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx) { (void)pio; (void)is_tx; return sm; }
+
+/* The fake DMA.  A transfer stays busy for a few polls of dma_channel_is_busy(), then delivers
+   its data to the state machine its channel was configured to write to. */
+
+#define DMA_CHANNELS 2
+#define DMA_BUSY_POLLS 3
+
+typedef struct {
+    bool claimed;
+    enum dma_channel_transfer_size size;
+    int sm;                     // state machine whose TX FIFO the channel writes
+    int busy_polls;
+    const volatile void *buf;
+    uint32_t count;
+    uint8_t copy[LCD_SNAPSHOT_BYTES];   // what buf held when the transfer started
+    int transfers;
+    int acks;
+} fake_dma_t;
+
+static fake_dma_t dma[DMA_CHANNELS];
+static int waits;
+
+static bool dma_busy_any() {
+    for (int i = 0; i < DMA_CHANNELS; i++) if (dma[i].busy_polls > 0) return true;
+    return false;
+}
+
+static uint32_t transfer_bytes(const fake_dma_t *d) {
+    return d->count << d->size;
+}
+
+static void dma_complete(fake_dma_t *d) {
+    CHECK(memcmp((const void *)d->buf, d->copy, transfer_bytes(d)) == 0);  // changed while being read
+    for (uint32_t i = 0; i < d->count; i++) {
+        if (d->size == DMA_SIZE_32) panel_rgb_word(((const uint32_t *)d->buf)[i]);
+        else panel_byte(((const uint8_t *)d->buf)[i]);
+    }
+    writes[n_writes - 1].transfers++;
+}
+
+int dma_claim_unused_channel(bool required) {
+    (void)required;
+    for (int i = 0; i < DMA_CHANNELS; i++) {
+        if (!dma[i].claimed) {
+            dma[i].claimed = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    return (dma_channel_config){DMA_SIZE_32, true, false, 0};
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { c->size = size; }
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) { c->read_increment = incr; }
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) { c->write_increment = incr; }
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) { c->dreq = dreq; }
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    (void)read_addr; (void)transfer_count;
+    fake_dma_t *d = &dma[channel];
+    CHECK(d->claimed);
+    CHECK(config->read_increment && !config->write_increment);
+    CHECK(!trigger);
+    d->size = config->size;
+    d->sm = -1;
+    for (int sm = 0; sm < 2; sm++) {
+        if (write_addr == &LCD_PIO->txf[sm]) d->sm = sm;
+    }
+    CHECK(d->sm >= 0);
+    CHECK_EQ(config->dreq, d->sm);
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+    flush_fifo();
+    fake_dma_t *d = &dma[channel];
+    CHECK(d->busy_polls == 0);      // a transfer already running would be cut short
+    CHECK(sm_enabled[d->sm]);
+    d->buf = read_addr;
+    d->count = transfer_count;
+    CHECK(transfer_bytes(d) <= LCD_SNAPSHOT_BYTES);
+    memcpy(d->copy, (const void *)read_addr, transfer_bytes(d));
+    d->busy_polls = DMA_BUSY_POLLS;
+    d->transfers++;
+}
+
+bool dma_channel_is_busy(uint channel) {
+    flush_fifo();
+    fake_dma_t *d = &dma[channel];
+    if (d->busy_polls == 0) return false;
+    if (--d->busy_polls == 0) dma_complete(d);
+    return true;
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) { (void)channel; CHECK(enabled); }
+void dma_channel_acknowledge_irq1(uint channel) { dma[channel].acks++; }
+
+void __wfe(void) {
+    flush_fifo();
+    waits++;
+}
+
+/* Helpers */
+
+static mutex_t test_mutex;
+
+static void setup() {
+    mutex_init(&test_mutex);
+    img_mutex = &test_mutex;
+    graphics_init(&test_mutex);
+    lcd_build_palette_wire();
+    lcd_pio_init();
+#if LCD_USE_PIO_RGB
+    lcd_rgb_pio_init();
+#endif
+#if LCD_USE_DMA
+    lcd_dma_init();
+#endif
+    gpio_put(LCD_PIN_DC, 1);
+}
+
+static void start_frame() {
+    flush_fifo();
+    memset(panel, 0xff, sizeof(panel));
+    n_writes = 0;
+    stats.bytes_pushed = 0;
+    for (int i = 0; i < DMA_CHANNELS; i++) dma[i].transfers = 0;
+}
+
+/* fill_image gives every pixel a colour from a hash of its position */
+static void fill_image(uint32_t seed) {
+    for (int y = 0; y < LCD_HEIGHT; y++) {
+        for (int x = 0; x < LCD_WIDTH; x++) {
+            uint32_t h = (x * 2654435761u) ^ (y * 40503u) ^ seed;
+            image_set(disp_image, x, y, (h >> 13) % 8);
+        }
+    }
+}
+
+/* push sends whatever is marked dirty, as core1_main() does */
+static int push() {
+    rect_t rects[MAX_DIRTY_RECTS];
+    int n = take_dirty_rects(rects);
+    for (int i = 0; i < n; i++) lcd_push_rect(&rects[i]);
+    flush_fifo();
+    return n;
+}
+
+/* The rect lcd_push_rect() actually sends for a dirty region */
+static rect_t sent_rect(rect_t r) {
+#if LCD_USE_PIO_RGB
+    uint16_t x_end = r.x + r.w;
+    r.x -= r.x % PIO_RGB_PIXELS_PER_WORD;
+    x_end += (PIO_RGB_PIXELS_PER_WORD - (x_end % PIO_RGB_PIXELS_PER_WORD)) % PIO_RGB_PIXELS_PER_WORD;
+    r.w = x_end - r.x;
+#endif
+    return r;
+}
+
+/* wire_byte is what the CPU sends for one channel of a palette entry - only the low bit of each
+   2-bit channel survives the <<7 into a byte */
+static uint8_t wire_byte(int channel_value) {
+    return (uint8_t)(channel_value << 7);
+}
+
+/* check_panel_matches compares the panel with the framebuffer over a region */
+static void check_panel_matches(rect_t r) {
+    int bad = 0;
+    for (int y = r.y; y < r.y + r.h; y++) {
+        for (int x = r.x; x < r.x + r.w; x++) {
+            rgb_t p = palette[image_get(disp_image, x, y)];
+            const uint8_t *got = panel[y][x];
+            if ((got[0] != wire_byte(p.b)) || (got[1] != wire_byte(p.g)) || (got[2] != wire_byte(p.r))) {
+                if (bad++ == 0) fprintf(stderr, "panel differs from image at %d,%d\n", x, y);
+            }
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+/* Tests */
+
+static void test_small_rect_window() {
+    start_frame();
+    fill_image(1);
+    mark_dirty(13, 20, 30, 7);
+    CHECK_EQ(push(), 1);
+    rect_t s = sent_rect((rect_t){13, 20, 30, 7});
+    CHECK_EQ(n_writes, 1);
+    CHECK_EQ(writes[0].x0, s.x);
+    CHECK_EQ(writes[0].x1, s.x + s.w - 1);
+    CHECK_EQ(writes[0].y0, 20);
+    CHECK_EQ(writes[0].y1, 26);
+    CHECK_EQ(writes[0].bytes, s.w * s.h * 3);
+    CHECK_EQ(stats.bytes_pushed, s.w * s.h * 3);
+#if LCD_USE_PIO_RGB
+    CHECK_EQ(s.x, 8);
+    CHECK_EQ(s.w, 40);
+#endif
+#if LCD_USE_DMA
+    CHECK_EQ(writes[0].transfers, 1);   // small enough for one snapshot
+#endif
+    check_panel_matches(s);
+}
+
+static void test_full_screen_chunks() {
+    start_frame();
+    fill_image(2);
+    mark_dirty(0, 0, LCD_WIDTH, LCD_HEIGHT);
+    CHECK_EQ(push(), 1);
+    CHECK_EQ(n_writes, 1);
+    CHECK_EQ(writes[0].x0, 0);
+    CHECK_EQ(writes[0].x1, LCD_WIDTH - 1);
+    CHECK_EQ(writes[0].y0, 0);
+    CHECK_EQ(writes[0].y1, LCD_HEIGHT - 1);
+    CHECK_EQ(writes[0].bytes, LCD_WIDTH * LCD_HEIGHT * 3);
+#if LCD_USE_DMA
+#if LCD_USE_PIO_RGB
+    int row_bytes = LCD_WIDTH / PIO_RGB_PIXELS_PER_WORD * 4;
+#else
+    int row_bytes = LCD_WIDTH * 3;
+#endif
+    int rows_per_chunk = LCD_SNAPSHOT_BYTES / row_bytes;
+    CHECK_EQ(writes[0].transfers, (LCD_HEIGHT + rows_per_chunk - 1) / rows_per_chunk);
+#endif
+    check_panel_matches((rect_t){0, 0, LCD_WIDTH, LCD_HEIGHT});
+}
+
+static void test_several_rects() {
+    static const rect_t dirty[] = {{0, 0, 5, 5}, {100, 40, 17, 3}, {470, 310, 10, 10}, {200, 150, 1, 1}};
+    const int n = sizeof(dirty) / sizeof(dirty[0]);
+    start_frame();
+    fill_image(3);
+    for (int i = 0; i < n; i++) mark_dirty(dirty[i].x, dirty[i].y, dirty[i].w, dirty[i].h);
+    CHECK_EQ(push(), n);
+    CHECK_EQ(n_writes, n);
+    uint32_t total = 0;
+    for (int i = 0; i < n && i < n_writes; i++) {
+        rect_t s = sent_rect(dirty[i]);
+        CHECK_EQ(writes[i].x0, s.x);
+        CHECK_EQ(writes[i].x1, s.x + s.w - 1);
+        CHECK_EQ(writes[i].y0, s.y);
+        CHECK_EQ(writes[i].y1, s.y + s.h - 1);
+        CHECK_EQ(writes[i].bytes, s.w * s.h * 3);
+        total += writes[i].bytes;
+        check_panel_matches(s);
+    }
+    CHECK_EQ(stats.bytes_pushed, total);
+}
+
+static void test_completion() {
+    start_frame();
+    fill_image(4);
+    mark_dirty(0, 0, LCD_WIDTH, 100);
+    push();
+    // lcd_push_rect() must not return with a transfer still reading a snapshot
+    CHECK(!dma_busy_any());
+    CHECK(sm_enabled[LCD_PIO_SM]);
+#if LCD_USE_PIO_RGB
+    CHECK(!sm_enabled[LCD_PIO_RGB_SM]);
+#endif
+#if LCD_USE_DMA
+    CHECK(waits > 0);       // core1 slept while the transfers ran
+    int acks = dma[0].acks + dma[1].acks;
+    lcd_dma_irq_handler();
+#if LCD_USE_PIO_RGB
+    CHECK_EQ(dma[0].acks + dma[1].acks, acks + 2);
+#else
+    CHECK_EQ(dma[0].acks + dma[1].acks, acks + 1);
+#endif
+#endif
+}
+
+/* The latency clock runs from the oldest update core1 has not yet taken */
+static void test_latency_clock() {
+    taken_gen = frame_gen;
+    fake_now_us = 10000;
+    lcd_invalidate_since(9000);
+    CHECK_EQ(oldest_submit_us, 9000);
+    lcd_invalidate();                   // newer - the clock keeps running from 9000
+    CHECK_EQ(oldest_submit_us, 9000);
+    lcd_invalidate_since(8500);         // a message that arrived earlier still
+    CHECK_EQ(oldest_submit_us, 8500);
+    taken_gen = frame_gen;              // core1 takes the frame
+    fake_now_us = 12000;
+    lcd_invalidate();
+    CHECK_EQ(oldest_submit_us, 12000);
+    taken_gen = frame_gen;
+    lcd_invalidate_since(11000);
+    CHECK_EQ(oldest_submit_us, 11000);
+}
+
+/* The lcd_rgb program must put exactly the bits on the wire, at the same rate, that the lcd program
+   does for the three bytes per pixel lcd_pio_put() used to send */
+static void test_rgb_program_matches_byte_program() {
+    for (int trial = 0; trial < 64; trial++) {
+        colour_t pixels[PIO_RGB_PIXELS_PER_WORD];
+        uint32_t word = 0;
+        uint32_t byte_words[PIO_RGB_PIXELS_PER_WORD * 3];
+        for (int i = 0; i < PIO_RGB_PIXELS_PER_WORD; i++) {
+            pixels[i] = (trial * 7 + i * 3 + (trial >> 3) * i) % 8;
+            rgb_t p = palette[pixels[i]];
+            word = (word << 3) | ((p.b & 1) << 2) | ((p.g & 1) << 1) | (p.r & 1);
+            // byte stores are replicated across the FIFO word
+            byte_words[i * 3] = wire_byte(p.b) * 0x01010101u;
+            byte_words[i * 3 + 1] = wire_byte(p.g) * 0x01010101u;
+            byte_words[i * 3 + 2] = wire_byte(p.r) * 0x01010101u;
+        }
+        word <<= 32 - (PIO_RGB_PIXELS_PER_WORD * 3);
+        pio_trace_t rgb, bytes;
+        pio_model_run(lcd_rgb_model, 4, PIO_RGB_PIXELS_PER_WORD * 3, &word, 1, &rgb);
+        pio_model_run(lcd_model, 2, 8, byte_words, PIO_RGB_PIXELS_PER_WORD * 3, &bytes);
+        CHECK_EQ(rgb.n_bits, PIO_RGB_PIXELS_PER_WORD * 3 * 8);
+        CHECK_EQ(rgb.n_bits, bytes.n_bits);
+        CHECK_EQ(rgb.cycles, bytes.cycles);
+        CHECK(memcmp(rgb.bits, bytes.bits, rgb.n_bits) == 0);
+    }
+}
+
+#if LCD_USE_PIO_RGB
+/* lcd_snapshot_rows() packing, read back through the model, for every nibble and word phase */
+static void test_snapshot_packing() {
+    fill_image(5);
+    for (int x = 0; x < 2 * PIO_RGB_PIXELS_PER_WORD; x++) {
+        start_frame();
+        mark_dirty(x, 7, 1 + x, 3);
+        push();
+        check_panel_matches(sent_rect((rect_t){x, 7, 1 + x, 3}));
+    }
+}
+#endif
+
+int main() {
+    setup();
+    RUN(test_small_rect_window);
+    RUN(test_full_screen_chunks);
+    RUN(test_several_rects);
+    RUN(test_completion);
+    RUN(test_latency_clock);
+    RUN(test_rgb_program_matches_byte_program);
+#if LCD_USE_PIO_RGB
+    RUN(test_snapshot_packing);
+#endif
+    return test_result();
+}
@@ -0,0 +1,499 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * mqtt.c against the broker stand-in in fake_broker.c.  It is included here so that the topic
+ * router can be checked directly, with topics chosen to collide in the hash table.
+ *
+ * Built with and without SUBSCRIBE_PER_ITEM (see CMakeLists.txt).  Both builds are sent the same
+ * broker traffic; the wildcard build saves the bytes it received to the file named on its
+ * command line, and the per-item build must receive fewer.
+*/
+
+#include <string.h>
+
+#include "fake_pico.h"
+#include "fake_broker.h"
+#include "test.h"
+
+#include "../src/mqtt.c"
+
+/* The info items of the selected layout, as info_items.c compiles them */
+#define LAYOUT_ITEM INFO_ITEM
+
+const info_item_t info_items[] = { LAYOUT_ITEMS };
+const int INFO_ITEM_COUNT = sizeof(info_items) / sizeof(info_items[0]);
+
+/* show_data records what it is given */
+static int shown_id = ID_UNKNOWN;
+static char shown[PAYLOAD_ARENA_SIZE + 1];
+static int shown_count;
+
+void show_data(int id, const char *data, int len) {
+    shown_id = id;
+    memcpy(shown, data, len);
+    shown[len] = '\0';
+    ++shown_count;
+}
+
+static void reset_routes() {
+    memset(topic_routes, 0, sizeof(topic_routes));
+    memset(routes_by_len, 0, sizeof(routes_by_len));
+}
+
+static int routes_used() {
+    int n = 0;
+    for (int i = 0; i < TOPIC_ROUTES; ++i) n += (topic_routes[i].topic != NULL);
+    return n;
+}
+
+static void test_layout_routes() {
+    reset_routes();
+    mqtt_setup_client();
+    int routed = 2;
+    for (int i = 0; i < INFO_ITEM_COUNT; ++i) {
+        if (is_clock_topic(info_items[i].topic)) {
+            CHECK_EQ(route_topic(info_items[i].topic), ID_UNKNOWN);     // drawn locally, never subscribed
+        } else {
+            CHECK_EQ(route_topic(info_items[i].topic), i);
+            ++routed;
+        }
+    }
+    CHECK_EQ(route_topic(URGENT_TOPIC), ID_URGENT);
+    CHECK_EQ(route_topic(MQTT_CONTROL_TOPIC), ID_CONTROL);
+    CHECK_EQ(routes_used(), routed);
+    const char *unknown[] = {"", "rgbmatrix", "rgbmatrix/", "rgbmatrix/#", "rgbmatrix/urgent/", "rgbmatrix/urgen",
+                             "rgbmatrix/kitchen/temperature", HUMIDITY_TOPIC, "zigbee2mqtt/lounge"};
+    for (unsigned int i = 0; i < sizeof(unknown) / sizeof(unknown[0]); ++i) CHECK_EQ(route_topic(unknown[i]), ID_UNKNOWN);
+}
+
+/* Topics all starting from the same table entry, so each is found by probing past the others.
+   The last table entry is chosen, so the probes also wrap around to the start. */
+static void test_bucket_collisions() {
+    static char topics[6][32];
+    int n = 0;
+    for (int i = 0; n < 6; ++i) {
+        snprintf(topics[n], sizeof(topics[n]), "rgbmatrix/sensor%d", i);
+        if ((topic_hash(topics[n]) & (TOPIC_ROUTES - 1)) == TOPIC_ROUTES - 1) ++n;
+    }
+    reset_routes();
+    for (int i = 0; i < 5; ++i) add_route(topics[i], 100 + i, 16);
+    CHECK_EQ(routes_used(), 5);
+    CHECK(topic_routes[0].topic != NULL);   // wrapped
+    for (int i = 0; i < 5; ++i) CHECK_EQ(route_topic(topics[i]), 100 + i);
+    CHECK_EQ(route_topic(topics[5]), ID_UNKNOWN);   // same start, not routed
+}
+
+/* Two topics with the same full hash must still be told apart by comparing them.  This pair was
+   found by hashing "rgbmatrix/%d/x" for the first 2^19 numbers. */
+static void test_hash_collisions() {
+    const char *a = "rgbmatrix/9098/x", *b = "rgbmatrix/398501/x";
+    CHECK_EQ(topic_hash(a), topic_hash(b));
+    reset_routes();
+    add_route(a, 1, 16);
+    CHECK_EQ(route_topic(b), ID_UNKNOWN);
+    add_route(b, 2, 16);
+    CHECK_EQ(routes_used(), 2);
+    CHECK_EQ(route_topic(a), 1);
+    CHECK_EQ(route_topic(b), 2);
+}
+
+/* A topic is compared directly with the only route of its length, and hashed once a second route
+   of that length is added */
+static void test_length_index() {
+    reset_routes();
+    add_route("rgbmatrix/aaa", 1, 16);
+    CHECK((routes_by_len[13] != 0) && (routes_by_len[13] != LEN_SHARED));
+    CHECK_EQ(route_topic("rgbmatrix/aaa"), 1);
+    CHECK_EQ(route_topic("rgbmatrix/aab"), ID_UNKNOWN);
+    add_route("rgbmatrix/bbb", 2, 16);
+    CHECK_EQ(routes_by_len[13], LEN_SHARED);
+    CHECK_EQ(route_topic("rgbmatrix/aaa"), 1);
+    CHECK_EQ(route_topic("rgbmatrix/bbb"), 2);
+    CHECK_EQ(route_topic("rgbmatrix/aab"), ID_UNKNOWN);
+}
+
+/* Topics of 63 characters or more share a length entry, and are told apart by comparing them */
+static void test_long_topics() {
+    char routed[80], other[80];
+    memset(routed, 'a', 70);
+    routed[70] = '\0';
+    memset(other, 'a', 79);
+    other[79] = '\0';
+    reset_routes();
+    add_route(routed, 3, 16);
+    CHECK_EQ(route_topic(routed), 3);
+    CHECK_EQ(route_topic(other), ID_UNKNOWN);
+    other[70] = '\0';
+    other[69] = 'b';
+    CHECK_EQ(route_topic(other), ID_UNKNOWN);
+}
+
+/* Info items may share a topic, which is routed to the first of them (info_items.c hands it
+   on to the rest).  Any other repeated topic keeps its first use. */
+static void test_shared_topics() {
+    reset_routes();
+    add_route("rgbmatrix/lounge", 0, 12);
+    add_route("rgbmatrix/lounge", 1, PAYLOAD_ARENA_SIZE);
+    add_route("rgbmatrix/lounge", 2, 20);
+    CHECK_EQ(routes_used(), 1);
+    CHECK_EQ(route_topic("rgbmatrix/lounge"), 0);
+    CHECK_EQ(find_route("rgbmatrix/lounge")->limit, PAYLOAD_ARENA_SIZE);    // room for every item's value
+
+    add_route(URGENT_TOPIC, ID_URGENT, 18);
+    add_route(URGENT_TOPIC, 1, 100);
+    add_route(MQTT_CONTROL_TOPIC, 0, 100);
+    add_route(MQTT_CONTROL_TOPIC, ID_CONTROL, CONTROL_PAYLOAD_MAX);
+    CHECK_EQ(routes_used(), 3);
+    CHECK_EQ(route_topic(URGENT_TOPIC), ID_URGENT);
+    CHECK_EQ(route_topic(MQTT_CONTROL_TOPIC), 0);
+    CHECK_EQ(find_route(URGENT_TOPIC)->limit, 18);
+    CHECK_EQ(find_route(MQTT_CONTROL_TOPIC)->limit, 100);
+}
+
+/* start_session connects afresh to a new broker */
+static void start_session() {
+    fake_time_reset();
+    fake_broker_reset();
+    reset_routes();
+    link_state = LINK_DOWN;
+    link_failures = 0;
+    memset(pub_queue, 0, sizeof(pub_queue));
+    pubs_in_flight = 0;
+    mqtt_setup_client();
+    mqtt_connect();
+    fake_broker_run();
+    CHECK(mqtt_connected());
+}
+
+static void check_subscriptions() {
+    fake_broker_stats_t st;
+    fake_broker_get_stats(&st);
+#if SUBSCRIBE_PER_ITEM
+    CHECK_EQ(fake_broker_subscriptions(), routes_used());
+    for (int i = 0; i < TOPIC_ROUTES; ++i) {
+        if (topic_routes[i].topic != NULL) CHECK(fake_broker_subscribed(topic_routes[i].topic));
+    }
+    CHECK(st.max_in_flight <= SUBSCRIBES_IN_FLIGHT);
+    CHECK_EQ(st.refused, 0);
+#else
+    CHECK_EQ(fake_broker_subscriptions(), 1);
+    CHECK(fake_broker_subscribed("rgbmatrix/anything/at/all"));
+#endif
+    CHECK(!fake_broker_subscribed("zigbee2mqtt/lounge"));
+}
+
+static FILE *counts;
+
+/* The traffic of a busy bus: every room's sensors, with the panel's own topics among them */
+static void test_subscription_traffic() {
+    const char *rooms[] = {"Pauls_Studio", "kitchen", "lounge", "office", "garage", "hall", "loft"};
+    const char *kinds[] = {"temperature", "humidity", "pressure", "battery", "linkquality", "motion"};
+    const char *shown_topics[MAX_TEXT_ITEMS + 2];
+    int n_shown = 0;
+    for (int i = 0; i < INFO_ITEM_COUNT; ++i) {
+        if (!is_clock_topic(info_items[i].topic)) shown_topics[n_shown++] = info_items[i].topic;
+    }
+    shown_topics[n_shown++] = URGENT_TOPIC;
+
+    start_session();
+    check_subscriptions();
+    fake_broker_stats_t before, after;
+    fake_broker_get_stats(&before);
+    int shown_before = shown_count, sent = 0, routed = 0;
+    char topic[64];
+    for (int round = 0; round < 10; ++round) {
+        for (unsigned int r = 0; r < sizeof(rooms) / sizeof(rooms[0]); ++r) {
+            for (unsigned int k = 0; k < sizeof(kinds) / sizeof(kinds[0]); ++k) {
+                snprintf(topic, sizeof(topic), "rgbmatrix/%s/%s", rooms[r], kinds[k]);
+                const char *payload = "{\"value\":21.5,\"unit\":\"C\"}";
+                const topic_route_t *route = find_route(topic);
+                fake_broker_publish(topic, payload);
+                ++sent;
+                routed += (route != NULL);      // and shown, cut short if need be
+            }
+        }
+        for (int i = 0; i < n_shown; ++i) {
+            fake_broker_publish(shown_topics[i], "12.5");
+            ++sent;
+            ++routed;
+        }
+    }
+    fake_broker_get_stats(&after);
+    uint32_t bytes = after.bytes_in - before.bytes_in;
+    CHECK_EQ(shown_count - shown_before, routed);
+#if SUBSCRIBE_PER_ITEM
+    CHECK_EQ(after.publishes_in - before.publishes_in, routed);
+    uint32_t wildcard_bytes = 0;
+    CHECK(fread(&wildcard_bytes, sizeof(wildcard_bytes), 1, counts) == 1);
+    printf("Received %lu bytes for %d publishes (subscribed to %s: %lu bytes)\n",
+           (unsigned long)bytes, routed, TOPIC, (unsigned long)wildcard_bytes);
+    CHECK(bytes < wildcard_bytes);
+#else
+    CHECK_EQ(after.publishes_in - before.publishes_in, sent);
+    printf("Received %lu bytes for %d publishes\n", (unsigned long)bytes, sent);
+    CHECK(fwrite(&bytes, sizeof(bytes), 1, counts) == 1);
+#endif
+}
+
+/* After the broker restarts, the client subscribes all over again */
+static void test_resubscribe() {
+    start_session();
+    fake_broker_stop();
+    CHECK(!mqtt_connected());
+    CHECK_EQ(fake_broker_subscriptions(), 0);
+    fake_broker_start();
+    fake_run_for_ms(RECONNECT_MAX_MS);
+    fake_broker_run();
+    CHECK(mqtt_connected());
+    check_subscriptions();
+}
+
+/* run_until_attempt moves time on until the next connection attempt, which the broker answers.
+   Returns false if there is none within a minute and a half. */
+static bool run_until_attempt() {
+    mqtt_link_stats_t ls;
+    mqtt_get_link_stats(&ls);
+    uint32_t attempts = ls.attempts;
+    for (int ms = 0; ms < RECONNECT_MAX_MS * 3 / 2; ms += 10) {
+        fake_run_for_ms(10);
+        mqtt_get_link_stats(&ls);
+        if (ls.attempts != attempts) {
+            fake_broker_run();
+            return true;
+        }
+    }
+    return false;
+}
+
+/* While the broker is down, attempts back off (doubling, with jitter) up to RECONNECT_MAX_MS; once
+   it is back, the client reconnects, subscribes again and is sent messages as before */
+static void test_broker_restart() {
+    start_session();
+    mqtt_link_stats_t ls0, ls;
+    mqtt_get_link_stats(&ls0);
+    uint64_t down_us = fake_now_us;
+    fake_broker_stop();
+    CHECK(!mqtt_connected());
+    CHECK(mqtt_reconnecting());
+    mqtt_get_link_stats(&ls);
+    CHECK_EQ(ls.disconnects, ls0.disconnects + 1);
+
+    uint32_t max_ms = RECONNECT_MIN_MS;
+    uint64_t last_us = fake_now_us;
+    for (int i = 0; i < 10; ++i) {
+        CHECK(run_until_attempt());
+        uint32_t waited_ms = (fake_now_us - last_us) / 1000;
+        last_us = fake_now_us;
+        CHECK(waited_ms >= max_ms / 2);
+        CHECK(waited_ms <= max_ms + 10);
+        if (max_ms < RECONNECT_MAX_MS) max_ms = (max_ms * 2 < RECONNECT_MAX_MS) ? max_ms * 2 : RECONNECT_MAX_MS;
+        CHECK(!mqtt_connected());
+    }
+    mqtt_get_link_stats(&ls);
+    CHECK_EQ(ls.attempts, ls0.attempts + 10);
+    CHECK_EQ(ls.failures, ls0.failures + 10);
+
+    fake_broker_start();
+    CHECK(run_until_attempt());
+    CHECK(mqtt_connected());
+    CHECK(!mqtt_reconnecting());
+    mqtt_get_link_stats(&ls);
+    CHECK_EQ(ls.connects, ls0.connects + 1);
+    CHECK_EQ(ls.latency_ms_last, (fake_now_us - down_us) / 1000);
+    check_subscriptions();
+    fake_broker_publish(URGENT_TOPIC, "BACK");
+    CHECK_EQ(shown_id, ID_URGENT);
+    CHECK(strcmp(shown, "BACK") == 0);
+}
+
+/* Publishes in flight when the connection drops, or queued while it is down, are sent once the
+   client reconnects - in either subscription mode */
+static void test_publish_resumes() {
+    static const char temp_topic[] = "rgbmatrix/panel/temperature";
+    static const char hum_topic[] = "rgbmatrix/panel/humidity";
+    start_session();
+    memset(&pub_stats, 0, sizeof(pub_stats));
+    fake_broker_stats_t st0, st;
+    fake_broker_get_stats(&st0);
+
+    CHECK(mqtt_queue_publish(temp_topic, "21.5", 4));     // handed to lwIP, but not yet sent
+    CHECK_EQ(pubs_in_flight, 1);
+    fake_broker_stop();                                     // ... and lost with the connection
+    CHECK(mqtt_queue_publish(hum_topic, "48", 2));
+    fake_broker_start();
+    CHECK(run_until_attempt());
+    CHECK(mqtt_connected());
+    fake_broker_run();
+
+    mqtt_pub_stats_t ps;
+    mqtt_get_pub_stats(&ps);
+    CHECK_EQ(ps.queued, 2);
+    CHECK_EQ(ps.retried, 1);
+    CHECK_EQ(ps.sent, 2);
+    CHECK_EQ(ps.dropped, 0);
+    CHECK_EQ(pubs_in_flight, 0);
+    fake_broker_get_stats(&st);
+    CHECK_EQ(st.publishes_out - st0.publishes_out, 3);     // the first twice
+    CHECK(strcmp(fake_broker_last_topic(), hum_topic) == 0);
+    CHECK(strcmp(fake_broker_last_payload(), "48") == 0);
+    // sharing the request slots with the subscriptions
+    CHECK_EQ(st.refused, 0);
+    CHECK(st.max_in_flight <= MQTT_REQ_MAX_IN_FLIGHT);
+    CHECK(fake_broker_subscribed(URGENT_TOPIC));
+}
+
+/* A broker address that cannot be parsed is a failed attempt, retried with backoff like any other */
+static void test_bad_address() {
+    fake_time_reset();
+    fake_broker_reset();
+    link_state = LINK_DOWN;
+    link_failures = 0;
+    mqtt_link_stats_t ls0, ls;
+    mqtt_get_link_stats(&ls0);
+    fake_broker_bad_address(true);
+    mqtt_connect();
+    mqtt_get_link_stats(&ls);
+    CHECK_EQ(ls.failures, ls0.failures + 1);
+    CHECK_EQ(link_state, LINK_WAITING);
+    CHECK(fake_worker_pending(&reconnect_worker));
+    CHECK(mqtt_reconnecting());
+    fake_broker_bad_address(false);
+    CHECK(run_until_attempt());
+    CHECK(mqtt_connected());
+}
+
+/* Publishes on the bus reach show_data() with their topic's ID, whole or in fragments */
+static void test_delivery() {
+    int item = -1;
+    for (int i = 0; (i < INFO_ITEM_COUNT) && (item < 0); ++i) {
+        if (!is_clock_topic(info_items[i].topic)) item = i;
+    }
+    CHECK(item >= 0);
+    if (item < 0) return;
+    start_session();
+
+    fake_broker_publish(info_items[item].topic, "21.5");
+    CHECK_EQ(shown_id, item);
+    CHECK(strcmp(shown, "21.5") == 0);
+    fake_broker_publish(URGENT_TOPIC, "DOOR OPEN");
+    CHECK_EQ(shown_id, ID_URGENT);
+    CHECK(strcmp(shown, "DOOR OPEN") == 0);
+
+    int before = shown_count;
+    fake_broker_publish("rgbmatrix/kitchen/temperature", "19");
+    fake_broker_publish(HUMIDITY_TOPIC, "55");
+    CHECK_EQ(shown_count, before);
+
+    fake_broker_set_fragment(3);
+    fake_broker_publish(info_items[item].topic, "-12.25");
+    CHECK_EQ(shown_id, item);
+    CHECK(strcmp(shown, "-12.25") == 0);
+    mqtt_rx_stats_t rx;
+    mqtt_get_rx_stats(&rx);
+    CHECK_EQ(rx.reassembled, 1);
+    fake_broker_set_fragment(0);
+}
+
+/* publish_len publishes a payload of len characters, returning how many of them show_data() had,
+   or -1 if it was not called */
+static int publish_len(const char *topic, int len) {
+    static char payload[PAYLOAD_ARENA_SIZE + 2];
+    for (int i = 0; i < len; ++i) payload[i] = '0' + (i % 10);
+    payload[len] = '\0';
+    int before = shown_count;
+    fake_broker_publish(topic, payload);
+    if (shown_count != before + 1) return -1;
+    CHECK(strncmp(shown, payload, strlen(shown)) == 0);     // the start of it
+    return strlen(shown);
+}
+
+/* Each topic keeps payloads up to its own limit - an item's max_chars with some slack - whole or
+   reassembled.  Longer ones are cut off there, and counted; only control commands are dropped. */
+static void test_payload_limits() {
+    start_session();
+    mqtt_rx_stats_t rx0, rx;
+    mqtt_get_rx_stats(&rx0);
+    int truncated = 0;
+    for (int i = 0; i < INFO_ITEM_COUNT; ++i) {
+        if (is_clock_topic(info_items[i].topic) || (route_topic(info_items[i].topic) != i)) continue;
+        int limit = info_items[i].max_chars + PAYLOAD_SLACK;
+        CHECK_EQ(publish_len(info_items[i].topic, limit), limit);
+        CHECK_EQ(publish_len(info_items[i].topic, limit + 1), limit);
+        fake_broker_set_fragment(3);
+        CHECK_EQ(publish_len(info_items[i].topic, limit), limit);
+        CHECK_EQ(publish_len(info_items[i].topic, limit + 1), limit);
+        CHECK_EQ(publish_len(info_items[i].topic, 3 * limit + 2), limit);
+        fake_broker_set_fragment(0);
+        truncated += 3;
+    }
+    CHECK_EQ(publish_len(URGENT_TOPIC, MAX_URGENT_CHARS + PAYLOAD_SLACK), MAX_URGENT_CHARS + PAYLOAD_SLACK);
+    CHECK_EQ(publish_len(URGENT_TOPIC, 40), MAX_URGENT_CHARS + PAYLOAD_SLACK);
+    ++truncated;
+    CHECK_EQ(publish_len(MQTT_CONTROL_TOPIC, CONTROL_PAYLOAD_MAX), CONTROL_PAYLOAD_MAX);
+    CHECK_EQ(publish_len(MQTT_CONTROL_TOPIC, CONTROL_PAYLOAD_MAX + 1), -1);
+    mqtt_get_rx_stats(&rx);
+    CHECK_EQ(rx.truncated - rx0.truncated, truncated);
+    CHECK_EQ(rx.overflows - rx0.overflows, 1);
+
+    // a JSON topic carries the rest of the message too
+    info_item_t json_item = INFO_ITEM("zigbee2mqtt/lounge", "temperature", "", "C", 0, 0, WHITE, BLACK, FONT_5X7, 1, 4);
+    CHECK_EQ(item_payload_limit(&json_item), PAYLOAD_ARENA_SIZE);
+}
+
+/* The sensor readings are formatted without printf's floating point */
+static void test_format_fixed() {
+    struct {
+        int32_t value;
+        int decimals;
+        const char *expect;
+    } cases[] = {
+        {213, 1, "21.3"}, {-213, 1, "-21.3"}, {5, 1, "0.5"}, {-5, 1, "-0.5"}, {0, 1, "0.0"}, {0, 0, "0"},
+        {-1, 0, "-1"}, {100, 1, "10.0"}, {-7, 2, "-0.07"}, {123456, 2, "1234.56"}, {987654321, 0, "987654321"},
+        {INT32_MAX, 1, "214748364.7"}, {INT32_MIN, 0, "-2147483648"},
+    };
+    for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        char buf[16];
+        int len = format_fixed(buf, cases[i].value, cases[i].decimals);
+        if ((len != (int)strlen(cases[i].expect)) || (memcmp(buf, cases[i].expect, len) != 0)) {
+            fprintf(stderr, "format_fixed(%d, %d) gave \"%.*s\", expected \"%s\"\n", (int)cases[i].value,
+                    cases[i].decimals, len, buf, cases[i].expect);
+            CHECK(false);
+        }
+    }
+    // rounded half away from zero, so a small negative reading is not shown as "-0.0"
+    CHECK_EQ(round_to_int(21.26f * 10.0f), 213);
+    CHECK_EQ(round_to_int(-21.26f * 10.0f), -213);
+    CHECK_EQ(round_to_int(-0.04f * 10.0f), 0);
+    CHECK_EQ(round_to_int(-0.06f * 10.0f), -1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s counts-file\n", argv[0]);
+        return 2;
+    }
+    counts = fopen(argv[1], SUBSCRIBE_PER_ITEM ? "rb" : "wb");
+    if (counts == NULL) {
+        perror(argv[1]);
+        return 2;
+    }
+    RUN(test_layout_routes);
+    RUN(test_bucket_collisions);
+    RUN(test_hash_collisions);
+    RUN(test_length_index);
+    RUN(test_long_topics);
+    RUN(test_shared_topics);
+    RUN(test_delivery);
+    RUN(test_payload_limits);
+    RUN(test_subscription_traffic);
+    RUN(test_resubscribe);
+    RUN(test_broker_restart);
+    RUN(test_publish_resumes);
+    RUN(test_bad_address);
+    RUN(test_format_fixed);
+    fclose(counts);
+    return test_result();
+}
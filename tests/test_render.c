@@ -0,0 +1,250 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * info_items.c driven through show_data(), with the panel modelled as core1 would fill it from
+ * each frame's dirty regions - copied from the framebuffer, or rendered band by band.
+ *
+ * Built with and without USE_BAND_RENDER (see CMakeLists.txt).  Each build checks that its panel
+ * is always what a full redraw would give, so no dirty region is missed.  The framebuffer build
+ * then saves the panel at every step of the scenario to the file named on its command line, and
+ * the band build requires its own panel to match it pixel for pixel.
+*/
+
+#include <string.h>
+
+#include "fake_pico.h"
+#include "test.h"
+
+#include "bands.h"
+#include "info_items.h"
+#include "lcd.h"
+#include "mqtt.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "sntp_clock.h"
+
+/* Just enough of the rest of the firmware to link info_items.c */
+
+char __StackLimit, __bss_end__;
+
+static int invalidations;
+static uint32_t last_since_us;
+
+void lcd_invalidate() { ++invalidations; }
+void lcd_invalidate_since(uint32_t since_us) { ++invalidations; last_since_us = since_us; }
+void lcd_off() {}
+void lcd_on() {}
+void lcd_brighten() {}
+void lcd_darken() {}
+void lcd_get_stats(lcd_stats_t *s) { memset(s, 0, sizeof(*s)); }
+void clock_get_stats(clock_stats_t *s) { memset(s, 0, sizeof(*s)); }
+int sched_job_count() { return 0; }
+void sched_get_job_stats(int job, sched_job_stats_t *s) { (void)job; memset(s, 0, sizeof(*s)); }
+void sensors_get_stats(sensor_stats_t *s) { memset(s, 0, sizeof(*s)); }
+void mqtt_get_rx_stats(mqtt_rx_stats_t *s) { memset(s, 0, sizeof(*s)); }
+void mqtt_get_pub_stats(mqtt_pub_stats_t *s) { memset(s, 0, sizeof(*s)); }
+void mqtt_get_link_stats(mqtt_link_stats_t *s) { memset(s, 0, sizeof(*s)); }
+
+/* Image mutex calls are counted, so the band build can check band_render() takes none */
+static int locks_taken;
+
+void mutex_enter_blocking(mutex_t *mtx) {
+    ++locks_taken;
+    CHECK(mtx->owner == 0);
+    mtx->owner = 1;
+}
+
+static mutex_t image_mutex;
+#if !USE_BAND_RENDER
+static image_t framebuffer;
+#endif
+static image_t panel;
+
+static void copy_rows(const image_row_t *src, int src_y0, const rect_t *r, int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+        for (int x = r->x; x < r->x + r->w; x++) image_set(panel, x, y, image_get(src, x, y - src_y0));
+    }
+}
+
+/* full_redraw gives what the panel should show, drawn from scratch */
+static void full_redraw(image_t out) {
+#if USE_BAND_RENDER
+    for (int y = 0; y < LCD_HEIGHT; y += BAND_LINES) {
+        int rows = (y + BAND_LINES > LCD_HEIGHT) ? LCD_HEIGHT - y : BAND_LINES;
+        memcpy(out[y], band_render(y, rows), rows * sizeof(out[0]));
+    }
+#else
+    memcpy(out, framebuffer, sizeof(image_t));
+#endif
+}
+
+/* push_frame does what core1 does for a frame: take the dirty regions, then send each one */
+static void push_frame() {
+    rect_t rects[MAX_DIRTY_RECTS];
+    mutex_enter_blocking(&image_mutex);
+    int n = take_dirty_rects(rects);
+#if USE_BAND_RENDER
+    band_take_items();
+#endif
+    mutex_exit(&image_mutex);
+    for (int i = 0; i < n; i++) {
+        const rect_t *r = &rects[i];
+#if USE_BAND_RENDER
+        for (int y = r->y; y < r->y + r->h; y += BAND_LINES) {
+            int y_end = (y + BAND_LINES < r->y + r->h) ? y + BAND_LINES : r->y + r->h;
+            int before = locks_taken;
+            image_row_t *band = band_render(y, y_end - y);
+            CHECK_EQ(locks_taken, before);
+            copy_rows(band, y, r, y, y_end);
+        }
+#else
+        copy_rows(framebuffer, 0, r, r->y, r->y + r->h);
+#endif
+    }
+
+    static image_t expected;
+    full_redraw(expected);
+    int bad = 0;
+    for (int y = 0; y < LCD_HEIGHT; y++) {
+        for (int x = 0; x < LCD_WIDTH; x++) {
+            if ((image_get(panel, x, y) != image_get(expected, x, y)) && (bad++ == 0)) {
+                fprintf(stderr, "panel missed an update at %d,%d\n", x, y);
+            }
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+/* The golden frames - written by the framebuffer build, compared by the band build */
+
+static FILE *golden;
+static int step;
+
+static void checkpoint(const char *what) {
+    ++step;
+#if USE_BAND_RENDER
+    static image_t want;
+    if (fread(want, sizeof(image_t), 1, golden) != 1) {
+        fprintf(stderr, "no golden frame for step %d (%s)\n", step, what);
+        CHECK(false);
+        return;
+    }
+    int bad = 0;
+    for (int y = 0; y < LCD_HEIGHT; y++) {
+        for (int x = 0; x < LCD_WIDTH; x++) {
+            if ((image_get(panel, x, y) != image_get(want, x, y)) && (bad++ == 0)) {
+                fprintf(stderr, "step %d (%s): band differs from framebuffer at %d,%d\n", step, what, x, y);
+            }
+        }
+    }
+    CHECK_EQ(bad, 0);
+#else
+    (void)what;
+    CHECK(fwrite(panel, sizeof(image_t), 1, golden) == 1);
+#endif
+}
+
+static void publish(int id, const char *payload) {
+    show_data(id, payload, strlen(payload));
+}
+
+/* settle lets any render tick due run, then sends the frame */
+static void settle() {
+    fake_run_for_ms(2 * INFO_RENDER_INTERVAL_MS);
+    push_frame();
+}
+
+static void test_scenario() {
+    int temp = -1, outside = -1;
+    for (int id = 0; id < INFO_ITEM_COUNT; id++) {
+        if (strcmp(info_items[id].topic, "rgbmatrix/Pauls_Studio/temperature") == 0) temp = id;
+        if (strcmp(info_items[id].topic, "rgbmatrix/outside_temp") == 0) outside = id;
+    }
+    CHECK(temp >= 0);
+    CHECK(outside >= 0);
+    if ((temp < 0) || (outside < 0)) return;
+
+    publish(0, "12:34");
+    publish(1, "Sat 17 Oct");
+    publish(temp, "21.5");
+    publish(outside, "7");
+    settle();
+    checkpoint("first values");
+
+    publish(0, "12:35");
+    publish(temp, "21.6");
+    publish(temp, "21.8");      // coalesced with the one before
+    settle();
+    checkpoint("changed characters");
+
+    publish(ID_URGENT, "DOOR OPEN");
+    push_frame();
+    checkpoint("urgent over the temperatures");
+
+    publish(0, "12:36");
+    settle();
+    checkpoint("clock while urgent");
+
+    hide_urgent();
+    push_frame();
+    checkpoint("urgent blinked off");
+    show_urgent();
+    push_frame();
+    checkpoint("urgent blinked on");
+
+    publish(ID_URGENT, "");
+    push_frame();               // before the covered items are redrawn
+    settle();
+    checkpoint("urgent cleared");
+
+    publish(outside, "8");
+    settle();
+    checkpoint("temperature after urgent");
+
+    publish(ID_URGENT, "HI");
+    push_frame();
+    publish(ID_URGENT, "");
+    settle();
+    publish(temp, "9.5");
+    settle();
+    checkpoint("short urgent cleared");
+}
+
+/* The LCD latency clock starts when the first of a frame's messages arrived, not at the render tick */
+static void test_latency_start() {
+    fake_run_for_ms(100);
+    uint32_t first_us = time_us_32();
+    publish(0, "12:40");
+    fake_run_for_ms(INFO_RENDER_INTERVAL_MS / 2);
+    publish(1, "Sun 18 Oct");
+    int before = invalidations;
+    settle();
+    CHECK_EQ(invalidations, before + 1);
+    CHECK_EQ(last_since_us, first_us);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s golden-file\n", argv[0]);
+        return 2;
+    }
+    golden = fopen(argv[1], USE_BAND_RENDER ? "rb" : "wb");
+    if (golden == NULL) {
+        perror(argv[1]);
+        return 2;
+    }
+    graphics_init(&image_mutex);
+#if USE_BAND_RENDER
+    info_setup(NULL);
+#else
+    info_setup(&framebuffer);
+#endif
+    RUN(test_scenario);
+    RUN(test_latency_start);
+    CHECK(invalidations > 0);
+    fclose(golden);
+    return test_result();
+}
@@ -0,0 +1,197 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * scheduler.c on a simulated port: jobs that take simulated time to run, to check fixed-rate
+ * deadlines, overrun counting and sched_wake() one-shots.  It is included here to drive
+ * sched_start() and sched_step() directly, as sched_run() never returns.
+*/
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../src/scheduler.c"
+
+/* The simulated port: time only passes while a job runs or the scheduler sleeps */
+static uint64_t sim_now_us;
+static int sleeps;
+
+uint64_t sched_port_now_us() { return sim_now_us; }
+
+void sched_port_sleep_until(uint64_t at_us) {
+    CHECK(at_us >= sim_now_us);
+    sim_now_us = at_us;
+    ++sleeps;
+}
+
+#define MS 1000ull
+#define START_US (5000 * MS)        // sched_run() is called a while after boot
+#define MAX_RUNS 64
+
+typedef struct {
+    int id;
+    uint32_t run_ms;            // how long each run takes
+    int runs;
+    uint64_t started_ms[MAX_RUNS];  // since START_US
+} test_job_t;
+
+static test_job_t job_a, job_b;
+
+static void run(test_job_t *t) {
+    if (t->runs < MAX_RUNS) t->started_ms[t->runs] = (sim_now_us - START_US) / MS;
+    ++t->runs;
+    sim_now_us += t->run_ms * MS;
+}
+
+static void job_a_fn() { run(&job_a); }
+static void job_b_fn() { run(&job_b); }
+
+static void reset_sched() {
+    memset(jobs, 0, sizeof(jobs));
+    job_count = 0;
+    memset(&job_a, 0, sizeof(job_a));
+    memset(&job_b, 0, sizeof(job_b));
+    sim_now_us = START_US;
+    sleeps = 0;
+}
+
+/* run_until runs the scheduler as sched_run() would, until end_ms after it started */
+static void run_until(uint64_t end_ms) {
+    uint64_t end = START_US + end_ms * MS;
+    while (true) {
+        uint64_t next = sched_step();
+        if (next > end) break;
+        sched_port_sleep_until(next);
+    }
+    if (sim_now_us < end) sim_now_us = end;
+}
+
+static void check_started(const test_job_t *t, const uint64_t *expect, int n) {
+    CHECK_EQ(t->runs, n);
+    for (int i = 0; (i < n) && (i < t->runs); ++i) {
+        if (t->started_ms[i] != expect[i]) {
+            fprintf(stderr, "run %d started at %llu ms, expected %llu\n", i, (unsigned long long)t->started_ms[i],
+                    (unsigned long long)expect[i]);
+            CHECK(false);
+        }
+    }
+}
+
+static void test_fixed_rate() {
+    reset_sched();
+    job_a.id = sched_add("a", 100, 30, job_a_fn);
+    job_a.run_ms = 20;
+    job_b.id = sched_add("b", 250, 0, job_b_fn);
+    job_b.run_ms = 5;
+    CHECK_EQ(sched_job_count(), 2);
+    sched_start();
+    run_until(999);
+    // the runs keep to the period, however long each takes
+    const uint64_t a[] = {30, 130, 230, 330, 430, 530, 630, 730, 830, 930};
+    const uint64_t b[] = {0, 250, 500, 750};
+    check_started(&job_a, a, 10);
+    check_started(&job_b, b, 4);
+    // and the scheduler slept until each deadline, rather than polling - except for b's at 250 and
+    // 750, which come just as a finishes
+    CHECK_EQ(sleeps, 10 + 4 - 3);
+    sched_job_stats_t s;
+    sched_get_job_stats(job_a.id, &s);
+    CHECK(strcmp(s.name, "a") == 0);
+    CHECK_EQ(s.period_ms, 100);
+    CHECK_EQ(s.runs, 10);
+    CHECK_EQ(s.overruns, 0);
+    CHECK_EQ(s.max_run_us, 20000);
+}
+
+/* A job still waiting to run when its next deadline passes has overrun; it then runs once, and the
+   later deadlines are kept */
+static void test_overruns() {
+    reset_sched();
+    job_a.id = sched_add("a", 100, 0, job_a_fn);
+    job_a.run_ms = 350;
+    job_b.id = sched_add("b", 100, 50, job_b_fn);
+    job_b.run_ms = 1;
+    sched_start();
+    run_until(0);                   // only a's first run is long
+    job_a.run_ms = 10;
+    run_until(599);
+    // a's own deadlines at 100 (due again), 200 and 300 (overruns) pass during its first run
+    const uint64_t a[] = {0, 351, 400, 500};
+    check_started(&job_a, a, 4);
+    // b's at 50 (due), 150, 250 and 350 (overruns) pass while it waits for a
+    const uint64_t b[] = {350, 450, 550};
+    check_started(&job_b, b, 3);
+    sched_job_stats_t s;
+    sched_get_job_stats(job_a.id, &s);
+    CHECK_EQ(s.overruns, 2);
+    CHECK_EQ(s.max_run_us, 350000);
+    sched_get_job_stats(job_b.id, &s);
+    CHECK_EQ(s.overruns, 3);
+}
+
+/* job_b is woken by job_a, and then wakes itself, as the DHT collection job polls */
+static int polls;
+
+static void poll_fn() {
+    run(&job_b);
+    if (--polls > 0) sched_wake(job_b.id, 10);
+}
+
+static void start_fn() {
+    run(&job_a);
+    sched_wake(job_b.id, 40);
+}
+
+static void test_wake() {
+    reset_sched();
+    job_a.id = sched_add("start", 1000, 100, start_fn);
+    job_b.id = sched_add("poll", 0, 0, poll_fn);
+    sched_start();
+    run_until(99);
+    CHECK_EQ(job_b.runs, 0);        // a period of 0 only runs when woken
+    polls = 3;
+    run_until(999);
+    const uint64_t a[] = {100};
+    const uint64_t b[] = {140, 150, 160};
+    check_started(&job_a, a, 1);
+    check_started(&job_b, b, 3);    // each wake runs it once only
+    sched_job_stats_t s;
+    sched_get_job_stats(job_b.id, &s);
+    CHECK_EQ(s.overruns, 0);
+
+    // of two pending wakes, the earlier is kept
+    polls = 0;
+    sched_wake(job_b.id, 50);
+    sched_wake(job_b.id, 20);
+    sched_wake(job_b.id, 30);
+    run_until(1099);
+    CHECK_EQ(job_b.runs, 4);
+    CHECK_EQ(job_b.started_ms[3], 1019);
+
+    // a wake that comes due while the job is still waiting to run is an overrun, and it runs once
+    sched_wake(job_b.id, 0);
+    mark_deadlines(sim_now_us);
+    sched_wake(job_b.id, 0);
+    sched_step();
+    CHECK_EQ(job_b.runs, 5);
+    sched_get_job_stats(job_b.id, &s);
+    CHECK_EQ(s.overruns, 1);
+}
+
+static void test_too_many() {
+    reset_sched();
+    for (int i = 0; i < SCHED_MAX_JOBS; ++i) CHECK_EQ(sched_add("x", 100, 0, job_a_fn), i);
+    CHECK_EQ(sched_add("x", 100, 0, job_a_fn), -1);
+    CHECK_EQ(sched_job_count(), SCHED_MAX_JOBS);
+}
+
+int main() {
+    RUN(test_fixed_rate);
+    RUN(test_overruns);
+    RUN(test_wake);
+    RUN(test_too_many);
+    return test_result();
+}
@@ -0,0 +1,242 @@
+/**
+ * SPDX-FileCopyrightText: 2023 Stephen Merrony
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * The DHT22 jobs in sensors.c against a fake sensor (fake_dht.c): a reading in time, a late one, a
+ * bad checksum, and a sensor that never replies, which must reset the driver without waiting on
+ * the DMA; and the latency and failure counts each leaves.  Then the filtering of the readings
+ * that pass: a wild one outvoted by the median, the deadbands and the heartbeat.  sensors.c is
+ * included here so that its state can be reset between tests.
+*/
+
+#include <string.h>
+
+#include "fake_dht.h"
+#include "fake_pico.h"
+#include "test.h"
+
+#include "../src/sensors.c"
+
+/* The scheduler: the sampling job is started by hand, and sched_wake() is a fake alarm */
+static sched_fn_t job_fns[2];
+static int job_count;
+
+int sched_add(const char *name, uint32_t period_ms, uint32_t first_ms, sched_fn_t fn) {
+    (void)name; (void)period_ms; (void)first_ms;
+    job_fns[job_count] = fn;
+    return job_count++;
+}
+
+static int64_t wake_cb(__attribute__((unused)) alarm_id_t id, void *user_data) {
+    job_fns[(intptr_t)user_data]();
+    return 0;
+}
+
+void sched_wake(int job, uint32_t delay_ms) {
+    add_alarm_in_ms(delay_ms, wake_cb, (void *)(intptr_t)job, true);
+}
+
+static int publishes;
+static float published_temp, published_hum;
+
+void publish_sensors(float temp, float hum) {
+    ++publishes;
+    published_temp = temp;
+    published_hum = hum;
+}
+
+static void reset_sensors() {
+    fake_time_reset();
+    fake_now_us = 60 * 1000000ull;
+    fake_dht_reset();
+    job_count = 0;
+    memset(&stats, 0, sizeof(stats));
+    ring_next = 0;
+    ring_count = 0;
+    published_once = false;
+    publishes = 0;
+    sensors_setup();
+    CHECK_EQ(job_count, 2);
+}
+
+/* read_once starts a measurement and lets the collection job run until it has finished */
+static void read_once() {
+    job_fns[0]();
+    fake_run_for_ms(DHT_TIMEOUT_MS + 2 * DHT_POLL_MS);
+    CHECK_EQ(fake_alarms_pending(), 0);
+}
+
+static bool near(float a, float b) {
+    return absf(a - b) < 0.001f;
+}
+
+static void check_no_misuse() {
+    fake_dht_stats_t d;
+    fake_dht_get_stats(&d);
+    CHECK_EQ(d.misuse, 0);
+}
+
+static void test_success() {
+    reset_sensors();
+    fake_dht_set_reply(DHT_RESULT_OK, 21.5f, 52.0f, 25000);
+    read_once();
+    CHECK_EQ(publishes, 1);
+    CHECK(near(published_temp, 21.5f + DHT_TEMP_OFFSET));
+    CHECK(near(published_hum, 52.0f + DHT_HUM_OFFSET));
+    // collected when first woken, without polling
+    CHECK_EQ(stats.reads, 1);
+    CHECK_EQ(stats.failures, 0);
+    CHECK_EQ(stats.latency_us_last, DHT_READ_MS * 1000);
+    CHECK_EQ(stats.latency_us_max, DHT_READ_MS * 1000);
+    CHECK_EQ(stats.latency_us_total, DHT_READ_MS * 1000);
+    check_no_misuse();
+}
+
+/* A reply after DHT_READ_MS is polled for every DHT_POLL_MS */
+static void test_late_reply() {
+    reset_sensors();
+    read_once();
+    fake_dht_set_reply(DHT_RESULT_OK, 21.0f, 50.0f, (DHT_READ_MS + 2 * DHT_POLL_MS + 1) * 1000);
+    read_once();
+    fake_dht_set_reply(DHT_RESULT_OK, 21.0f, 50.0f, 1000);
+    read_once();
+    uint32_t late_us = (DHT_READ_MS + 3 * DHT_POLL_MS) * 1000;
+    CHECK_EQ(stats.reads, 3);
+    CHECK_EQ(stats.failures, 0);
+    CHECK_EQ(stats.latency_us_last, DHT_READ_MS * 1000);
+    CHECK_EQ(stats.latency_us_max, late_us);
+    CHECK_EQ(stats.latency_us_total, 2 * DHT_READ_MS * 1000 + late_us);
+    check_no_misuse();
+}
+
+static void test_bad_checksum() {
+    reset_sensors();
+    read_once();
+    fake_dht_set_reply(DHT_RESULT_BAD_CHECKSUM, 99.0f, 99.0f, 25000);
+    read_once();
+    CHECK_EQ(stats.reads, 2);
+    CHECK_EQ(stats.failures, 1);
+    CHECK_EQ(stats.timeouts, 0);
+    // the failed read is neither filtered nor timed
+    CHECK_EQ(ring_count, 1);
+    CHECK_EQ(stats.latency_us_total, DHT_READ_MS * 1000);
+    // a timeout reported by the driver itself
+    fake_dht_set_reply(DHT_RESULT_TIMEOUT, 0.0f, 0.0f, 25000);
+    read_once();
+    CHECK_EQ(stats.failures, 2);
+    CHECK_EQ(stats.timeouts, 1);
+    CHECK_EQ(ring_count, 1);
+    check_no_misuse();
+}
+
+/* A sensor that never replies leaves the DMA busy: after DHT_TIMEOUT_MS the driver is reset, with
+   the transfer still in progress, rather than waited on */
+static void test_timeout() {
+    reset_sensors();
+    fake_dht_set_reply(DHT_RESULT_OK, 21.0f, 50.0f, FAKE_DHT_NO_REPLY);
+    job_fns[0]();
+    fake_run_for_ms(DHT_TIMEOUT_MS - 1);
+    CHECK_EQ(fake_alarms_pending(), 1);     // still polling
+    CHECK_EQ(stats.failures, 0);
+    fake_run_for_ms(2 * DHT_POLL_MS);
+    CHECK_EQ(fake_alarms_pending(), 0);
+    CHECK_EQ(stats.failures, 1);
+    CHECK_EQ(stats.timeouts, 1);
+    CHECK_EQ(stats.latency_us_total, 0);
+    fake_dht_stats_t d;
+    fake_dht_get_stats(&d);
+    CHECK_EQ(d.deinits, 1);
+    CHECK_EQ(d.deinits_busy, 1);
+    CHECK_EQ(d.inits, 2);
+    CHECK_EQ(d.finishes, 0);                // which would have blocked
+    CHECK_EQ(publishes, 0);
+
+    // the reset driver reads normally
+    fake_dht_set_reply(DHT_RESULT_OK, 21.0f, 50.0f, 25000);
+    read_once();
+    CHECK_EQ(stats.reads, 2);
+    CHECK_EQ(stats.failures, 1);
+    CHECK_EQ(publishes, 1);
+    CHECK_EQ(stats.latency_us_last, DHT_READ_MS * 1000);
+    check_no_misuse();
+}
+
+/* read_value takes a reading of temp and hum, DHT_SAMPLE_PERIOD_MS after the last */
+static void read_value(float temp, float hum) {
+    fake_now_us += (DHT_SAMPLE_PERIOD_MS - DHT_TIMEOUT_MS - 2 * DHT_POLL_MS) * 1000ull;
+    fake_dht_set_reply(DHT_RESULT_OK, temp, hum, 25000);
+    read_once();
+}
+
+/* A single wild reading is outvoted by the median, and moves nothing */
+static void test_median_rejects_glitch() {
+    reset_sensors();
+    for (int i = 0; i < 3; ++i) read_value(21.0f, 50.0f);
+    CHECK_EQ(publishes, 1);
+    read_value(85.0f, 99.0f);
+    CHECK(near(temp_ema, 21.0f + DHT_TEMP_OFFSET));
+    CHECK(near(hum_ema, 50.0f + DHT_HUM_OFFSET));
+    CHECK_EQ(publishes, 1);
+    CHECK_EQ(stats.suppressed, 3);
+    // nor does one in a full ring
+    read_value(21.0f, 50.0f);
+    read_value(-40.0f, 0.0f);
+    CHECK_EQ(ring_count, SAMPLE_RING_LEN);
+    CHECK(near(temp_ema, 21.0f + DHT_TEMP_OFFSET));
+    CHECK(near(hum_ema, 50.0f + DHT_HUM_OFFSET));
+    CHECK_EQ(publishes, 1);
+    CHECK_EQ(stats.suppressed, 5);
+}
+
+/* A change inside the deadbands is filtered but not published, until it grows beyond one */
+static void test_deadband() {
+    reset_sensors();
+    read_value(21.0f, 50.0f);
+    CHECK_EQ(publishes, 1);
+    for (int i = 0; i < 20; ++i) read_value(21.1f, 50.5f);
+    CHECK(near(temp_ema, 21.1f + DHT_TEMP_OFFSET));
+    CHECK_EQ(publishes, 1);
+    CHECK_EQ(stats.published, 1);
+    CHECK_EQ(stats.suppressed, 20);
+    CHECK(near(published_temp, 21.0f + DHT_TEMP_OFFSET));
+
+    // the median follows on the third reading of five, which takes the average past the deadband
+    read_value(21.5f, 50.5f);
+    read_value(21.5f, 50.5f);
+    CHECK_EQ(publishes, 1);
+    read_value(21.5f, 50.5f);
+    CHECK_EQ(publishes, 2);
+    CHECK_EQ(stats.published, 2);
+    CHECK_EQ(stats.suppressed, 22);
+    CHECK(published_temp - (21.0f + DHT_TEMP_OFFSET) >= TEMP_DEADBAND);
+    // and the next change is measured from what was published
+    read_value(21.5f, 50.5f);
+    CHECK_EQ(publishes, 2);
+    CHECK_EQ(stats.suppressed, 23);
+}
+
+/* An unchanged reading is published again once PUBLISH_HEARTBEAT_MS has passed */
+static void test_heartbeat() {
+    reset_sensors();
+    read_value(21.0f, 50.0f);
+    CHECK_EQ(publishes, 1);
+    for (int i = 1; i < PUBLISH_HEARTBEAT_MS / DHT_SAMPLE_PERIOD_MS; ++i) read_value(21.0f, 50.0f);
+    CHECK_EQ(publishes, 1);
+    read_value(21.0f, 50.0f);
+    CHECK_EQ(publishes, 2);
+    CHECK(near(published_temp, 21.0f + DHT_TEMP_OFFSET));
+    CHECK_EQ(stats.suppressed, PUBLISH_HEARTBEAT_MS / DHT_SAMPLE_PERIOD_MS - 1);
+}
+
+int main() {
+    RUN(test_success);
+    RUN(test_late_reply);
+    RUN(test_bad_checksum);
+    RUN(test_timeout);
+    RUN(test_median_rejects_glitch);
+    RUN(test_deadband);
+    RUN(test_heartbeat);
+    return test_result();
+}